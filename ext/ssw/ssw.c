@@ -77,6 +77,10 @@
 #include "sse2neon.h"
 #else // x86 (Intel)
 #include <emmintrin.h>
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SSW_WIDE_KERNELS 1
+#include <immintrin.h>
+#endif
 #endif
 
 
@@ -112,9 +116,20 @@ typedef struct {
 	int32_t length;
 } cigar;
 
+/* Query profile and Smith-Waterman functions for one vector width */
+typedef struct {
+	int32_t vector_bytes;
+	void* (*profile_byte) (const int8_t*, const int8_t*, const int32_t, const int32_t, uint8_t);
+	void* (*profile_word) (const int8_t*, const int8_t*, const int32_t, const int32_t);
+	alignment_end* (*sw_byte) (const int8_t*, int8_t, int32_t, int32_t, const uint8_t, const uint8_t, const void*, uint8_t, uint8_t, int32_t);
+	alignment_end* (*sw_word) (const int8_t*, int8_t, int32_t, int32_t, const uint8_t, const uint8_t, const void*, uint16_t, int32_t);
+	void (*free_profile) (void*);
+} ssw_kernels;
+
 struct _profile{
-	__m128i* profile_byte;	// 0: none
-	__m128i* profile_word;	// 0: none
+	void* profile_byte;	// 0: none
+	void* profile_word;	// 0: none
+	const ssw_kernels* kernels;
 	const int8_t* read;
 	const int8_t* mat;
 	int32_t readLen;
@@ -160,7 +175,7 @@ const uint8_t encoded_ops[] = {
 };
 
 /* Generate query profile rearrange query sequence & calculate the weight of match/mismatch. */
-static __m128i* qP_byte (const int8_t* read_num,
+static void* qP_byte (const int8_t* read_num,
 				  const int8_t* mat,
 				  const int32_t readLen,
 				  const int32_t n,	/* the edge length of the squre matrix mat */
@@ -200,7 +215,7 @@ static alignment_end* sw_sse2_byte (const int8_t* ref,
 							 int32_t readLen,
 							 const uint8_t weight_gapO, /* will be used as - */
 							 const uint8_t weight_gapE, /* will be used as - */
-							 const __m128i* vProfile,
+							 const void* profile,
 							 uint8_t terminate,	/* the best alignment score: used to terminate
 												   the matrix calculation when locating the
 												   alignment beginning point. If this score
@@ -208,6 +223,8 @@ static alignment_end* sw_sse2_byte (const int8_t* ref,
 	 						 uint8_t bias,  /* Shift 0 point to a positive value. */
 							 int32_t maskLen) {
 
+	const __m128i* vProfile = (const __m128i*)profile;
+
     // Put the largest number of the 16 numbers in vm into m.
     #define max16(m, vm) (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 8)); \
 					  (vm) = _mm_max_epu8((vm), _mm_srli_si128((vm), 4)); \
@@ -385,7 +402,7 @@ end:
 	return bests;
 }
 
-static __m128i* qP_word (const int8_t* read_num,
+static void* qP_word (const int8_t* read_num,
 				  const int8_t* mat,
 				  const int32_t readLen,
 				  const int32_t n) {
@@ -415,10 +432,12 @@ static alignment_end* sw_sse2_word (const int8_t* ref,
 							 int32_t readLen,
 							 const uint8_t weight_gapO, /* will be used as - */
 							 const uint8_t weight_gapE, /* will be used as - */
-							 const __m128i* vProfile,
+							 const void* profile,
 							 uint16_t terminate,
 							 int32_t maskLen) {
 
+	const __m128i* vProfile = (const __m128i*)profile;
+
 #define max8(m, vm) (vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 8)); \
 					(vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 4)); \
 					(vm) = _mm_max_epi16((vm), _mm_srli_si128((vm), 2)); \
@@ -587,6 +606,126 @@ end:
 	return bests;
 }
 
+static const ssw_kernels kernels_sse2 = {
+	16,
+	qP_byte,
+	qP_word,
+	sw_sse2_byte,
+	sw_sse2_word,
+	free
+};
+
+#ifdef SSW_WIDE_KERNELS
+
+#define SSW_SUFFIX avx2
+#define SSW_TARGET __attribute__((target("avx2")))
+#define SSW_VEC __m256i
+#define SSW_BYTES 32
+#define SSW_LOAD(p) _mm256_load_si256(p)
+#define SSW_STORE(p, v) _mm256_store_si256((p), (v))
+#define SSW_ZERO() _mm256_setzero_si256()
+#define SSW_SET1_8(x) _mm256_set1_epi8(x)
+#define SSW_SET1_16(x) _mm256_set1_epi16(x)
+#define SSW_ADDS_U8 _mm256_adds_epu8
+#define SSW_SUBS_U8 _mm256_subs_epu8
+#define SSW_MAX_U8 _mm256_max_epu8
+#define SSW_ADDS_I16 _mm256_adds_epi16
+#define SSW_SUBS_U16 _mm256_subs_epu16
+#define SSW_MAX_I16 _mm256_max_epi16
+/* _mm256_alignr_epi8 shifts within 128-bit lanes; the permute brings in the bytes of the lower lane */
+#define SSW_SHIFT_BYTES(v, n) _mm256_alignr_epi8((v), _mm256_permute2x128_si256((v), (v), 0x08), 16 - (n))
+#define SSW_ALL_ZERO(v) _mm256_testz_si256((v), (v))
+#define SSW_EQUAL(a, b) (_mm256_movemask_epi8(_mm256_cmpeq_epi8((a), (b))) == -1)
+#define SSW_ANY_GT_I16(a, b) (_mm256_movemask_epi8(_mm256_cmpgt_epi16((a), (b))) != 0)
+#define SSW_HMAX_U8(v) hmax_u8_avx2(v)
+#define SSW_HMAX_I16(v) hmax_i16_avx2(v)
+
+static inline __attribute__((target("avx2"))) uint8_t hmax_u8_avx2(__m256i v) {
+	__m128i m = _mm_max_epu8(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+	m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+	return (uint8_t)_mm_extract_epi16(m, 0);
+}
+
+static inline __attribute__((target("avx2"))) uint16_t hmax_i16_avx2(__m256i v) {
+	__m128i m = _mm_max_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+	m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+	return (uint16_t)_mm_extract_epi16(m, 0);
+}
+
+#include "ssw_wide.h"
+
+#undef SSW_SUFFIX
+#undef SSW_TARGET
+#undef SSW_VEC
+#undef SSW_BYTES
+#undef SSW_LOAD
+#undef SSW_STORE
+#undef SSW_ZERO
+#undef SSW_SET1_8
+#undef SSW_SET1_16
+#undef SSW_ADDS_U8
+#undef SSW_SUBS_U8
+#undef SSW_MAX_U8
+#undef SSW_ADDS_I16
+#undef SSW_SUBS_U16
+#undef SSW_MAX_I16
+#undef SSW_SHIFT_BYTES
+#undef SSW_ALL_ZERO
+#undef SSW_EQUAL
+#undef SSW_ANY_GT_I16
+#undef SSW_HMAX_U8
+#undef SSW_HMAX_I16
+
+#define SSW_SUFFIX avx512
+#define SSW_TARGET __attribute__((target("avx512f,avx512bw,avx2")))
+#define SSW_VEC __m512i
+#define SSW_BYTES 64
+#define SSW_LOAD(p) _mm512_load_si512((const void*)(p))
+#define SSW_STORE(p, v) _mm512_store_si512((void*)(p), (v))
+#define SSW_ZERO() _mm512_setzero_si512()
+#define SSW_SET1_8(x) _mm512_set1_epi8(x)
+#define SSW_SET1_16(x) _mm512_set1_epi16(x)
+#define SSW_ADDS_U8 _mm512_adds_epu8
+#define SSW_SUBS_U8 _mm512_subs_epu8
+#define SSW_MAX_U8 _mm512_max_epu8
+#define SSW_ADDS_I16 _mm512_adds_epi16
+#define SSW_SUBS_U16 _mm512_subs_epu16
+#define SSW_MAX_I16 _mm512_max_epi16
+/* valignd moves whole 128-bit lanes up by one, then _mm512_alignr_epi8 shifts within lanes */
+#define SSW_SHIFT_BYTES(v, n) _mm512_alignr_epi8((v), _mm512_alignr_epi32((v), _mm512_setzero_si512(), 12), 16 - (n))
+#define SSW_ALL_ZERO(v) (_mm512_test_epi8_mask((v), (v)) == 0)
+#define SSW_EQUAL(a, b) (_mm512_cmpneq_epu8_mask((a), (b)) == 0)
+#define SSW_ANY_GT_I16(a, b) (_mm512_cmpgt_epi16_mask((a), (b)) != 0)
+#define SSW_HMAX_U8(v) hmax_u8_avx2(_mm256_max_epu8(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64((v), 1)))
+#define SSW_HMAX_I16(v) hmax_i16_avx2(_mm256_max_epi16(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64((v), 1)))
+
+#include "ssw_wide.h"
+
+#endif // SSW_WIDE_KERNELS
+
+/* Kernels used by ssw_init; SSE2 unless ssw_set_vector_width is called */
+static const ssw_kernels* selected_kernels = &kernels_sse2;
+
+int32_t ssw_set_vector_width(int32_t bits) {
+	selected_kernels = &kernels_sse2;
+#ifdef SSW_WIDE_KERNELS
+	__builtin_cpu_init();
+	if (bits >= 512 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+		selected_kernels = &kernels_avx512;
+	} else if (bits >= 256 && __builtin_cpu_supports("avx2")) {
+		selected_kernels = &kernels_avx2;
+	}
+#else
+	(void)bits;
+#endif
+	return selected_kernels->vector_bytes * 8;
+}
+
 static cigar* banded_sw (const int8_t* ref,
 				 const int8_t* read,
 				 int32_t refLen,
@@ -786,10 +925,11 @@ static int8_t* seq_reverse(const int8_t* seq, int32_t end)	/* end is 0-based ali
 	return reverse;
 }
 
-s_profile* ssw_init (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n, const int8_t score_size) {
+static s_profile* init_profile (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n, const int8_t score_size, const ssw_kernels* kernels) {
 	s_profile* p = (s_profile*)calloc(1, sizeof(struct _profile));
 	p->profile_byte = 0;
 	p->profile_word = 0;
+	p->kernels = kernels;
 	p->bias = 0;
 
 	if (score_size == 0 || score_size == 2) {
@@ -799,9 +939,9 @@ s_profile* ssw_init (const int8_t* read, const int32_t readLen, const int8_t* ma
 		bias = abs(bias);
 
 		p->bias = bias;
-		p->profile_byte = qP_byte (read, mat, readLen, n, bias);
+		p->profile_byte = p->kernels->profile_byte (read, mat, readLen, n, bias);
 	}
-	if (score_size == 1 || score_size == 2) p->profile_word = qP_word (read, mat, readLen, n);
+	if (score_size == 1 || score_size == 2) p->profile_word = p->kernels->profile_word (read, mat, readLen, n);
 	p->read = read;
 	p->mat = mat;
 	p->readLen = readLen;
@@ -809,9 +949,13 @@ s_profile* ssw_init (const int8_t* read, const int32_t readLen, const int8_t* ma
 	return p;
 }
 
+s_profile* ssw_init (const int8_t* read, const int32_t readLen, const int8_t* mat, const int32_t n, const int8_t score_size) {
+	return init_profile(read, readLen, mat, n, score_size, selected_kernels);
+}
+
 void init_destroy (s_profile* p) {
-	free(p->profile_byte);
-	free(p->profile_word);
+	p->kernels->free_profile(p->profile_byte);
+	p->kernels->free_profile(p->profile_word);
 	free(p);
 }
 
@@ -826,7 +970,8 @@ s_align* ssw_align (const s_profile* prof,
 					const int32_t maskLen) {
 
 	alignment_end* bests = 0, *bests_reverse = 0;
-	__m128i* vP = 0;
+	const ssw_kernels* kernels = prof->kernels;
+	void* vP = 0;
 	int32_t word = 0, band_width = 0, readLen = prof->readLen;
 	int8_t* read_reverse = 0;
 	cigar* path;
@@ -840,12 +985,22 @@ s_align* ssw_align (const s_profile* prof,
 		fprintf(stderr, "When maskLen < 15, the function ssw_align doesn't return 2nd best alignment information.\n");
 	}
 
+	if (kernels != &kernels_sse2 && weight_gapO <= weight_gapE) {
+		/* The wider kernels require weight_gapO > weight_gapE. Otherwise, the lazy-F loop does not always find
+		   the optimal score, and the result would depend on the vector width. */
+		s_profile* p = init_profile(prof->read, readLen, prof->mat, prof->n, prof->profile_byte ? (prof->profile_word ? 2 : 0) : 1, &kernels_sse2);
+		free(r);
+		r = ssw_align(p, ref, refLen, weight_gapO, weight_gapE, flag, filters, filterd, maskLen);
+		init_destroy(p);
+		return r;
+	}
+
 	// Find the alignment scores and ending positions
 	if (prof->profile_byte) {
-		bests = sw_sse2_byte(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen);
+		bests = kernels->sw_byte(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_byte, -1, prof->bias, maskLen);
 		if (prof->profile_word && bests[0].score == 255) {
 			free(bests);
-			bests = sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
+			bests = kernels->sw_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
 			word = 1;
 		} else if (bests[0].score == 255) {
 			fprintf(stderr, "Please set 2 to the score_size parameter of the function ssw_init, otherwise the alignment results will be incorrect.\n");
@@ -853,7 +1008,7 @@ s_align* ssw_align (const s_profile* prof,
 			return NULL;
 		}
 	}else if (prof->profile_word) {
-		bests = sw_sse2_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
+		bests = kernels->sw_word(ref, 0, refLen, readLen, weight_gapO, weight_gapE, prof->profile_word, -1, maskLen);
 		word = 1;
 	}else {
 		fprintf(stderr, "Please call the function ssw_init before ssw_align.\n");
@@ -876,13 +1031,13 @@ s_align* ssw_align (const s_profile* prof,
 	// Find the beginning position of the best alignment.
 	read_reverse = seq_reverse(prof->read, r->read_end1);
 	if (word == 0) {
-		vP = qP_byte(read_reverse, prof->mat, r->read_end1 + 1, prof->n, prof->bias);
-		bests_reverse = sw_sse2_byte(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, prof->bias, maskLen);
+		vP = kernels->profile_byte(read_reverse, prof->mat, r->read_end1 + 1, prof->n, prof->bias);
+		bests_reverse = kernels->sw_byte(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, prof->bias, maskLen);
 	} else {
-		vP = qP_word(read_reverse, prof->mat, r->read_end1 + 1, prof->n);
-		bests_reverse = sw_sse2_word(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, maskLen);
+		vP = kernels->profile_word(read_reverse, prof->mat, r->read_end1 + 1, prof->n);
+		bests_reverse = kernels->sw_word(ref, 1, r->ref_end1 + 1, r->read_end1 + 1, weight_gapO, weight_gapE, vP, r->score1, maskLen);
 	}
-	free(vP);
+	kernels->free_profile(vP);
 	free(read_reverse);
 	r->ref_begin1 = bests_reverse[0].ref;
 	r->read_begin1 = r->read_end1 - bests_reverse[0].read;
@@ -65,6 +65,14 @@ typedef struct {
     uint16_t flag;
 } s_align;
 
+/*!	@function	Choose the vector width of the Smith-Waterman kernels used by profiles created afterwards.
+	@param	bits	maximum vector width: 128 (SSE2), 256 (AVX2) or 512 (AVX-512); the widest width up to this that the CPU
+					supports is used
+	@return	the vector width that is used
+	@note	Not thread safe. Without calling this function, the 128-bit SSE2 kernels are used.
+*/
+int32_t ssw_set_vector_width(int32_t bits);
+
 /*!	@function	Create the query profile using the query sequence.
 	@param	read	pointer to the query sequence; the query sequence needs to be numbers
 	@param	readLen	length of the query sequence
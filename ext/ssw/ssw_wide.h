@@ -0,0 +1,440 @@
+/*
+ *  ssw_wide.h
+ *
+ *	Striped Smith-Waterman kernels for vectors wider than 128 bits.
+ *
+ *	This file is included by ssw.c once for each vector width. The kernels
+ *	are the same as sw_sse2_byte and sw_sse2_word (and the query profile
+ *	functions qP_byte and qP_word), but with SSW_BYTES bytes per vector and
+ *	a prefix maximum instead of the lazy-F loop (see lane_carry_byte). They
+ *	compute the same alignment scores and positions. Before including,
+ *	define:
+ *
+ *	SSW_SUFFIX	suffix of the function names
+ *	SSW_TARGET	function attribute that enables the instruction set
+ *	SSW_VEC	vector type
+ *	SSW_BYTES	bytes per vector
+ *	SSW_LOAD(p), SSW_STORE(p, v), SSW_ZERO(), SSW_SET1_8(x), SSW_SET1_16(x)
+ *	SSW_ADDS_U8, SSW_SUBS_U8, SSW_MAX_U8, SSW_ADDS_I16, SSW_SUBS_U16, SSW_MAX_I16
+ *	SSW_SHIFT_BYTES(v, n)	shift the entire vector by n bytes towards the higher lanes
+ *	SSW_ALL_ZERO(v)	whether all bits of v are zero
+ *	SSW_EQUAL(a, b)	whether a and b are equal
+ *	SSW_ANY_GT_I16(a, b)	whether any 16-bit lane of a is greater than that of b
+ *	SSW_HMAX_U8(v), SSW_HMAX_I16(v)	largest 8-bit (unsigned) or 16-bit (signed) lane of v
+ */
+
+#define SSW_CONCAT_(a, b) a##_##b
+#define SSW_CONCAT(a, b) SSW_CONCAT_(a, b)
+#define SSW_NAME(name) SSW_CONCAT(name, SSW_SUFFIX)
+#define SSW_LANES8 SSW_BYTES
+#define SSW_LANES16 (SSW_BYTES / 2)
+
+/* Allocate n zeroed vectors */
+static SSW_TARGET SSW_VEC* SSW_NAME(calloc_vectors) (int32_t n) {
+	SSW_VEC* v = (SSW_VEC*)_mm_malloc(n * sizeof(SSW_VEC), SSW_BYTES);
+	memset(v, 0, n * sizeof(SSW_VEC));
+	return v;
+}
+
+static void SSW_NAME(free_profile) (void* profile) {
+	_mm_free(profile);
+}
+
+/*	The lazy-F loop needs about one sweep over the column per segLen rows that
+	F propagates, so with wide vectors (small segLen) it costs as much as
+	the main loop. Instead, compute the F that enters the first row of each
+	lane directly: vF holds the F leaving the last row of each lane as
+	computed by the main loop, and lane k receives the largest of these from
+	the lanes above it, reduced by weight_gapE for each row in between. This
+	is a prefix maximum over the lanes. A single sweep then applies it. This
+	gives the same result as the lazy-F loop if weight_gapO > weight_gapE,
+	which ssw_align ensures by using the SSE2 kernels otherwise. */
+#define SSW_CARRY_STEP(max, subs, set1, limit, v, shifted, lanes) \
+	v = max(v, subs(shifted, set1(decay * (lanes) > limit ? limit : decay * (lanes))))
+
+static inline SSW_TARGET SSW_VEC SSW_NAME(lane_carry_byte) (SSW_VEC vF, int32_t segLen, uint8_t weight_gapE) {
+	int32_t decay = segLen * weight_gapE;
+	SSW_VEC v = SSW_SHIFT_BYTES(vF, 1);
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(v, 1), 1);
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(v, 2), 2);
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(v, 4), 4);
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(v, 8), 8);
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(v, 16), 16);
+#if SSW_BYTES == 64
+	SSW_CARRY_STEP(SSW_MAX_U8, SSW_SUBS_U8, SSW_SET1_8, 255, v, SSW_SHIFT_BYTES(SSW_SHIFT_BYTES(v, 16), 16), 32);
+#endif
+	return v;
+}
+
+static inline SSW_TARGET SSW_VEC SSW_NAME(lane_carry_word) (SSW_VEC vF, int32_t segLen, uint16_t weight_gapE) {
+	int32_t decay = segLen * weight_gapE;
+	SSW_VEC v = SSW_SHIFT_BYTES(vF, 2);
+	SSW_CARRY_STEP(SSW_MAX_I16, SSW_SUBS_U16, SSW_SET1_16, 65535, v, SSW_SHIFT_BYTES(v, 2), 1);
+	SSW_CARRY_STEP(SSW_MAX_I16, SSW_SUBS_U16, SSW_SET1_16, 65535, v, SSW_SHIFT_BYTES(v, 4), 2);
+	SSW_CARRY_STEP(SSW_MAX_I16, SSW_SUBS_U16, SSW_SET1_16, 65535, v, SSW_SHIFT_BYTES(v, 8), 4);
+	SSW_CARRY_STEP(SSW_MAX_I16, SSW_SUBS_U16, SSW_SET1_16, 65535, v, SSW_SHIFT_BYTES(v, 16), 8);
+#if SSW_BYTES == 64
+	SSW_CARRY_STEP(SSW_MAX_I16, SSW_SUBS_U16, SSW_SET1_16, 65535, v, SSW_SHIFT_BYTES(SSW_SHIFT_BYTES(v, 16), 16), 16);
+#endif
+	return v;
+}
+
+#undef SSW_CARRY_STEP
+
+static SSW_TARGET void* SSW_NAME(qP_byte) (const int8_t* read_num,
+				  const int8_t* mat,
+				  const int32_t readLen,
+				  const int32_t n,
+				  uint8_t bias) {
+
+	int32_t segLen = (readLen + SSW_LANES8 - 1) / SSW_LANES8;
+	SSW_VEC* vProfile = (SSW_VEC*)_mm_malloc(n * segLen * sizeof(SSW_VEC), SSW_BYTES);
+	int8_t* t = (int8_t*)vProfile;
+	int32_t nt, i, j, segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < SSW_LANES8) ; segNum ++) {
+				*t++ = j>= readLen ? bias : mat[nt * n + read_num[j]] + bias;
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+static SSW_TARGET alignment_end* SSW_NAME(sw_byte) (const int8_t* ref,
+							 int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+							 int32_t refLen,
+							 int32_t readLen,
+							 const uint8_t weight_gapO,
+							 const uint8_t weight_gapE,
+							 const void* profile,
+							 uint8_t terminate,
+							 uint8_t bias,
+							 int32_t maskLen) {
+
+	const SSW_VEC* vProfile = (const SSW_VEC*)profile;
+	uint8_t max = 0;
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = -1;
+	int32_t segLen = (readLen + SSW_LANES8 - 1) / SSW_LANES8;
+
+	uint8_t* maxColumn = (uint8_t*) calloc(refLen, 1);
+
+	SSW_VEC vZero = SSW_ZERO();
+
+	SSW_VEC* pvHStore = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvHLoad = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvE = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvHmax = SSW_NAME(calloc_vectors)(segLen);
+
+	int32_t i, j;
+	SSW_VEC vGapO = SSW_SET1_8(weight_gapO);
+	SSW_VEC vGapE = SSW_SET1_8(weight_gapE);
+	SSW_VEC vBias = SSW_SET1_8(bias);
+
+	SSW_VEC vMaxScore = vZero;
+	SSW_VEC vMaxMark = vZero;
+	SSW_VEC vTemp;
+	int32_t edge, begin = 0, end = refLen, step = 1;
+
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		SSW_VEC e, vF = vZero, vMaxColumn = vZero;
+
+		SSW_VEC vH = pvHStore[segLen - 1];
+		vH = SSW_SHIFT_BYTES(vH, 1);
+		const SSW_VEC* vP = vProfile + ref[i] * segLen;
+
+		SSW_VEC* pv = pvHLoad;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = SSW_ADDS_U8(vH, SSW_LOAD(vP + j));
+			vH = SSW_SUBS_U8(vH, vBias);
+
+			e = SSW_LOAD(pvE + j);
+			vH = SSW_MAX_U8(vH, e);
+			vH = SSW_MAX_U8(vH, vF);
+			vMaxColumn = SSW_MAX_U8(vMaxColumn, vH);
+
+			SSW_STORE(pvHStore + j, vH);
+
+			vH = SSW_SUBS_U8(vH, vGapO);
+			e = SSW_SUBS_U8(e, vGapE);
+			e = SSW_MAX_U8(e, vH);
+			SSW_STORE(pvE + j, e);
+
+			vF = SSW_SUBS_U8(vF, vGapE);
+			vF = SSW_MAX_U8(vF, vH);
+
+			vH = SSW_LOAD(pvHLoad + j);
+		}
+
+		/* Single sweep with the F entering each lane, instead of the lazy-F loop */
+		vF = SSW_NAME(lane_carry_byte)(vF, segLen, weight_gapE);
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = SSW_LOAD(pvHStore + j);
+			vH = SSW_MAX_U8(vH, vF);
+			vMaxColumn = SSW_MAX_U8(vMaxColumn, vH);
+			SSW_STORE(pvHStore + j, vH);
+			vH = SSW_SUBS_U8(vH, vGapO);
+			vF = SSW_SUBS_U8(vF, vGapE);
+			vTemp = SSW_SUBS_U8(vF, vH);
+			if (UNLIKELY(SSW_ALL_ZERO(vTemp))) break;
+		}
+
+		vMaxScore = SSW_MAX_U8(vMaxScore, vMaxColumn);
+		if (!SSW_EQUAL(vMaxMark, vMaxScore)) {
+			uint8_t temp;
+			vMaxMark = vMaxScore;
+			temp = SSW_HMAX_U8(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				if (max + bias >= 255) break;	//overflow
+				end_ref = i;
+
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		maxColumn[i] = SSW_HMAX_U8(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint8_t *t = (uint8_t*)pvHmax;
+	int32_t column_len = segLen * SSW_LANES8;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SSW_LANES8 + i % SSW_LANES8 * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	_mm_free(pvHmax);
+	_mm_free(pvE);
+	_mm_free(pvHLoad);
+	_mm_free(pvHStore);
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_end* bests = (alignment_end*) calloc(2, sizeof(alignment_end));
+	bests[0].score = max + bias >= 255 ? 255 : max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+
+	bests[1].score = 0;
+	bests[1].ref = 0;
+	bests[1].read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
+	for (i = edge + 1; i < refLen; i ++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+
+	free(maxColumn);
+	return bests;
+}
+
+static SSW_TARGET void* SSW_NAME(qP_word) (const int8_t* read_num,
+				  const int8_t* mat,
+				  const int32_t readLen,
+				  const int32_t n) {
+
+	int32_t segLen = (readLen + SSW_LANES16 - 1) / SSW_LANES16;
+	SSW_VEC* vProfile = (SSW_VEC*)_mm_malloc(n * segLen * sizeof(SSW_VEC), SSW_BYTES);
+	int16_t* t = (int16_t*)vProfile;
+	int32_t nt, i, j;
+	int32_t segNum;
+
+	for (nt = 0; LIKELY(nt < n); nt ++) {
+		for (i = 0; i < segLen; i ++) {
+			j = i;
+			for (segNum = 0; LIKELY(segNum < SSW_LANES16) ; segNum ++) {
+				*t++ = j>= readLen ? 0 : mat[nt * n + read_num[j]];
+				j += segLen;
+			}
+		}
+	}
+	return vProfile;
+}
+
+static SSW_TARGET alignment_end* SSW_NAME(sw_word) (const int8_t* ref,
+							 int8_t ref_dir,	// 0: forward ref; 1: reverse ref
+							 int32_t refLen,
+							 int32_t readLen,
+							 const uint8_t weight_gapO,
+							 const uint8_t weight_gapE,
+							 const void* profile,
+							 uint16_t terminate,
+							 int32_t maskLen) {
+
+	const SSW_VEC* vProfile = (const SSW_VEC*)profile;
+	uint16_t max = 0;
+	int32_t end_read = readLen - 1;
+	int32_t end_ref = 0;
+	int32_t segLen = (readLen + SSW_LANES16 - 1) / SSW_LANES16;
+
+	uint16_t* maxColumn = (uint16_t*) calloc(refLen, 2);
+
+	SSW_VEC vZero = SSW_ZERO();
+
+	SSW_VEC* pvHStore = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvHLoad = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvE = SSW_NAME(calloc_vectors)(segLen);
+	SSW_VEC* pvHmax = SSW_NAME(calloc_vectors)(segLen);
+
+	int32_t i, j;
+	SSW_VEC vGapO = SSW_SET1_16(weight_gapO);
+	SSW_VEC vGapE = SSW_SET1_16(weight_gapE);
+
+	SSW_VEC vMaxScore = vZero;
+	SSW_VEC vMaxMark = vZero;
+	int32_t edge, begin = 0, end = refLen, step = 1;
+
+	if (ref_dir == 1) {
+		begin = refLen - 1;
+		end = -1;
+		step = -1;
+	}
+	for (i = begin; LIKELY(i != end); i += step) {
+		SSW_VEC e, vF = vZero;
+		SSW_VEC vH = pvHStore[segLen - 1];
+		vH = SSW_SHIFT_BYTES(vH, 2);
+
+		SSW_VEC* pv = pvHLoad;
+
+		SSW_VEC vMaxColumn = vZero;
+
+		const SSW_VEC* vP = vProfile + ref[i] * segLen;
+		pvHLoad = pvHStore;
+		pvHStore = pv;
+
+		for (j = 0; LIKELY(j < segLen); j ++) {
+			vH = SSW_ADDS_I16(vH, SSW_LOAD(vP + j));
+
+			e = SSW_LOAD(pvE + j);
+			vH = SSW_MAX_I16(vH, e);
+			vH = SSW_MAX_I16(vH, vF);
+			vMaxColumn = SSW_MAX_I16(vMaxColumn, vH);
+
+			SSW_STORE(pvHStore + j, vH);
+
+			vH = SSW_SUBS_U16(vH, vGapO);
+			e = SSW_SUBS_U16(e, vGapE);
+			e = SSW_MAX_I16(e, vH);
+			SSW_STORE(pvE + j, e);
+
+			vF = SSW_SUBS_U16(vF, vGapE);
+			vF = SSW_MAX_I16(vF, vH);
+
+			vH = SSW_LOAD(pvHLoad + j);
+		}
+
+		/* Single sweep with the F entering each lane, instead of the lazy-F loop */
+		vF = SSW_NAME(lane_carry_word)(vF, segLen, weight_gapE);
+		for (j = 0; LIKELY(j < segLen); ++j) {
+			vH = SSW_LOAD(pvHStore + j);
+			vH = SSW_MAX_I16(vH, vF);
+			vMaxColumn = SSW_MAX_I16(vMaxColumn, vH);
+			SSW_STORE(pvHStore + j, vH);
+			vH = SSW_SUBS_U16(vH, vGapO);
+			vF = SSW_SUBS_U16(vF, vGapE);
+			if (UNLIKELY(!SSW_ANY_GT_I16(vF, vH))) break;
+		}
+
+		vMaxScore = SSW_MAX_I16(vMaxScore, vMaxColumn);
+		if (!SSW_EQUAL(vMaxMark, vMaxScore)) {
+			uint16_t temp;
+			vMaxMark = vMaxScore;
+			temp = SSW_HMAX_I16(vMaxScore);
+
+			if (LIKELY(temp > max)) {
+				max = temp;
+				end_ref = i;
+				for (j = 0; LIKELY(j < segLen); ++j) pvHmax[j] = pvHStore[j];
+			}
+		}
+
+		maxColumn[i] = SSW_HMAX_I16(vMaxColumn);
+		if (maxColumn[i] == terminate) break;
+	}
+
+	/* Trace the alignment ending position on read. */
+	uint16_t *t = (uint16_t*)pvHmax;
+	int32_t column_len = segLen * SSW_LANES16;
+	for (i = 0; LIKELY(i < column_len); ++i, ++t) {
+		int32_t temp;
+		if (*t == max) {
+			temp = i / SSW_LANES16 + i % SSW_LANES16 * segLen;
+			if (temp < end_read) end_read = temp;
+		}
+	}
+
+	_mm_free(pvHmax);
+	_mm_free(pvE);
+	_mm_free(pvHLoad);
+	_mm_free(pvHStore);
+
+	/* Find the most possible 2nd best alignment. */
+	alignment_end* bests = (alignment_end*) calloc(2, sizeof(alignment_end));
+	bests[0].score = max;
+	bests[0].ref = end_ref;
+	bests[0].read = end_read;
+
+	bests[1].score = 0;
+	bests[1].ref = 0;
+	bests[1].read = 0;
+
+	edge = (end_ref - maskLen) > 0 ? (end_ref - maskLen) : 0;
+	for (i = 0; i < edge; i ++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+	edge = (end_ref + maskLen) > refLen ? refLen : (end_ref + maskLen);
+	for (i = edge; i < refLen; i ++) {
+		if (maxColumn[i] > bests[1].score) {
+			bests[1].score = maxColumn[i];
+			bests[1].ref = i;
+		}
+	}
+
+	free(maxColumn);
+	return bests;
+}
+
+static const ssw_kernels SSW_NAME(kernels) = {
+	SSW_BYTES,
+	SSW_NAME(qP_byte),
+	SSW_NAME(qP_word),
+	SSW_NAME(sw_byte),
+	SSW_NAME(sw_word),
+	SSW_NAME(free_profile)
+};
+
+#undef SSW_CONCAT_
+#undef SSW_CONCAT
+#undef SSW_NAME
+#undef SSW_LANES8
+#undef SSW_LANES16
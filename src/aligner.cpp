@@ -2,13 +2,15 @@
  * Low-level alignment functions
  *
  * This is for anything that returns an aln_info object, currently
- * Aligner::align and hamming_align.
+ * Aligner::align, hamming_align and banded_align.
  */
 #include <sstream>
 #include <tuple>
 #include <algorithm>
 #include <cassert>
+#include <limits>
 #include "aligner.hpp"
+#include "simd.hpp"
 
 std::optional<AlignmentInfo> Aligner::align(const std::string &query, const std::string &ref) const {
     m_align_calls++;
@@ -102,6 +104,27 @@ std::optional<AlignmentInfo> Aligner::align(const std::string &query, const std:
     return aln;
 }
 
+namespace {
+
+STROBEALIGN_ALWAYS_INLINE int hamming_distance_impl(const char* s, const char* t, size_t n) {
+    int mismatches = 0;
+    for (size_t i = 0; i < n; i++) {
+        mismatches += s[i] != t[i];
+    }
+    return mismatches;
+}
+
+STROBEALIGN_DEFINE_SIMD_VARIANTS(int, hamming_distance, (const char* s, const char* t, size_t n), (s, t, n))
+
+}  // namespace
+
+int hamming_distance(const std::string &s, const std::string &t) {
+    if (s.length() != t.length()){
+        return -1;
+    }
+    STROBEALIGN_SIMD_DISPATCH_RETURN(simd_level(), hamming_distance, (s.data(), t.data(), s.length()));
+}
+
 /*
  * Find highest-scoring segment between reference and query assuming only matches
  * and mismatches are allowed.
@@ -194,6 +217,180 @@ AlignmentInfo hamming_align(
     return aln;
 }
 
+/*
+ * Local alignment with affine gap costs restricted to a band.
+ *
+ * For each query prefix length i (0 <= i <= query.length()), only reference
+ * prefix lengths j with |j - band_center[i]| <= band_width are considered.
+ * The band centers are usually obtained by interpolating between seed anchors,
+ * which makes it possible to align queries that are much longer than what
+ * Aligner::align() accepts in time and memory proportional to
+ * query.length() * band_width.
+ *
+ * A gap of length L costs gap_open + (L-1) * gap_extend (as in SSW).
+ * The end_bonus is added for each end of the query that is reached, unaligned
+ * query ends are soft clipped.
+ */
+AlignmentInfo banded_align(
+    const std::string& query, const std::string& ref, const std::vector<int>& band_center, int band_width, const AlignmentParameters& parameters
+) {
+    constexpr int NEG = std::numeric_limits<int>::min() / 2;
+    // Traceback bits
+    constexpr uint8_t FROM_START = 0, FROM_DIAG = 1, FROM_DEL = 2, FROM_INS = 3;
+    constexpr uint8_t DEL_EXTENDED = 4, INS_EXTENDED = 8;
+
+    const int n = query.length();
+    const int m = ref.length();
+    const int width = 2 * band_width + 1;
+    assert(band_center.size() == query.length() + 1);
+
+    auto lo = [&](int i) { return band_center[i] - band_width; };
+
+    std::vector<uint8_t> traceback(static_cast<size_t>(n + 1) * width, FROM_START);
+    std::vector<int> h_prev(width, NEG), f_prev(width, NEG), h_cur(width), f_cur(width);
+
+    int best_score = 0;
+    int best_i = 0;
+    int best_j = 0;
+
+    // An alignment starting at the beginning of the query gets the end bonus
+    for (int k = 0; k < width; k++) {
+        int j = lo(0) + k;
+        h_prev[k] = (j >= 0 && j <= m) ? parameters.end_bonus : NEG;
+    }
+    for (int i = 1; i <= n; i++) {
+        const int lo_i = lo(i);
+        const int shift = lo_i - lo(i - 1);
+        int e = NEG;
+        for (int k = 0; k < width; k++) {
+            const int j = lo_i + k;
+            if (j < 0 || j > m) {
+                h_cur[k] = f_cur[k] = NEG;
+                e = NEG;
+                continue;
+            }
+            uint8_t tb = FROM_START;
+            int h = 0;
+
+            // Diagonal: cell (i-1, j-1) is at k + shift - 1 in the previous row
+            const int k_diag = k + shift - 1;
+            if (j > 0 && k_diag >= 0 && k_diag < width && h_prev[k_diag] > NEG) {
+                int score = h_prev[k_diag] + (query[i - 1] == ref[j - 1] ? parameters.match : -parameters.mismatch);
+                if (score > h) {
+                    h = score;
+                    tb = FROM_DIAG;
+                }
+            }
+
+            // Insertion (gap in the reference): from cell (i-1, j)
+            const int k_up = k + shift;
+            int f = NEG;
+            if (k_up >= 0 && k_up < width) {
+                int open = h_prev[k_up] - parameters.gap_open;
+                int extend = f_prev[k_up] - parameters.gap_extend;
+                if (extend > open) {
+                    f = extend;
+                    tb |= INS_EXTENDED;
+                } else {
+                    f = open;
+                }
+            }
+
+            // Deletion (gap in the query): from cell (i, j-1)
+            if (k > 0) {
+                int open = h_cur[k - 1] - parameters.gap_open;
+                int extend = e - parameters.gap_extend;
+                if (extend > open) {
+                    e = extend;
+                    tb |= DEL_EXTENDED;
+                } else {
+                    e = open;
+                }
+            } else {
+                e = NEG;
+            }
+
+            if (e > h) {
+                h = e;
+                tb = (tb & ~3) | FROM_DEL;
+            }
+            if (f > h) {
+                h = f;
+                tb = (tb & ~3) | FROM_INS;
+            }
+            h_cur[k] = h;
+            f_cur[k] = f;
+            traceback[static_cast<size_t>(i) * width + k] = tb;
+
+            int score = h + (i == n ? parameters.end_bonus : 0);
+            if (score > best_score) {
+                best_score = score;
+                best_i = i;
+                best_j = j;
+            }
+        }
+        std::swap(h_prev, h_cur);
+        std::swap(f_prev, f_cur);
+    }
+
+    AlignmentInfo aln;
+    if (best_score == 0) {
+        return aln;
+    }
+
+    // Trace back from the best cell
+    Cigar cigar;
+    int i = best_i;
+    int j = best_j;
+    unsigned int edits = 0;
+    uint8_t state = FROM_DIAG;  // any state other than a gap state means H
+    while (i > 0) {
+        uint8_t tb = traceback[static_cast<size_t>(i) * width + (j - lo(i))];
+        if (state == FROM_DEL) {
+            cigar.push(CIGAR_DEL, 1);
+            edits++;
+            state = (tb & DEL_EXTENDED) ? FROM_DEL : FROM_DIAG;
+            j--;
+            continue;
+        }
+        if (state == FROM_INS) {
+            cigar.push(CIGAR_INS, 1);
+            edits++;
+            state = (tb & INS_EXTENDED) ? FROM_INS : FROM_DIAG;
+            i--;
+            continue;
+        }
+        uint8_t from = tb & 3;
+        if (from == FROM_START) {
+            break;
+        } else if (from == FROM_DIAG) {
+            bool is_match = query[i - 1] == ref[j - 1];
+            cigar.push(is_match ? CIGAR_EQ : CIGAR_X, 1);
+            edits += !is_match;
+            i--;
+            j--;
+        } else {
+            state = from;
+        }
+    }
+    if (i > 0) {
+        cigar.push(CIGAR_SOFTCLIP, i);
+    }
+    cigar.reverse();
+    if (best_i < n) {
+        cigar.push(CIGAR_SOFTCLIP, n - best_i);
+    }
+
+    aln.cigar = std::move(cigar);
+    aln.edit_distance = edits;
+    aln.sw_score = best_score;
+    aln.ref_start = j;
+    aln.ref_end = best_j;
+    aln.query_start = i;
+    aln.query_end = best_i;
+    return aln;
+}
+
 std::ostream& operator<<(std::ostream& os, const AlignmentParameters& params) {
     os
         << "AlignmentParameters("
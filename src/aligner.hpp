@@ -3,6 +3,7 @@
 
 #include <string>
 #include <tuple>
+#include <vector>
 #include <optional>
 #include "ssw/ssw_cpp.h"
 #include "cigar.hpp"
@@ -52,20 +53,7 @@ private:
     mutable unsigned m_align_calls{0};  // no. of calls to the align() method
 };
 
-inline int hamming_distance(const std::string &s, const std::string &t) {
-    if (s.length() != t.length()){
-        return -1;
-    }
-
-    int mismatches = 0;
-    for (size_t i = 0; i < s.length(); i++) {
-        if (s[i] != t[i]) {
-            mismatches++;
-        }
-    }
-
-    return mismatches;
-}
+int hamming_distance(const std::string &s, const std::string &t);
 
 std::tuple<size_t, size_t, int> highest_scoring_segment(
     const std::string& query, const std::string& ref, int match, int mismatch, int end_bonus
@@ -75,4 +63,8 @@ AlignmentInfo hamming_align(
     const std::string &query, const std::string &ref, int match, int mismatch, int end_bonus
 );
 
+AlignmentInfo banded_align(
+    const std::string& query, const std::string& ref, const std::vector<int>& band_center, int band_width, const AlignmentParameters& parameters
+);
+
 #endif
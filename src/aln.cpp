@@ -4,6 +4,8 @@
 #include <iostream>
 #include <math.h>
 #include <sstream>
+#include <optional>
+#include <cstring>
 #include "revcomp.hpp"
 #include "timer.hpp"
 #include "nam.hpp"
@@ -14,10 +16,20 @@ using namespace klibpp;
 
 namespace {
 
+// NAMs on the same reference and strand whose projected reference start
+// positions differ by at most this much are extended only once
+// (see merge_nams_at_same_locus())
+constexpr int same_locus_tolerance = 10;
+
+/*
+ * A pair of NAMs, given as indices into the NAM vectors of the two mates.
+ * An index of -1 marks a "dummy" NAM (the mate is unmapped or needs to be
+ * rescued).
+ */
 struct NamPair {
     float score;
-    Nam nam1;
-    Nam nam2;
+    int nam1;
+    int nam2;
 };
 
 struct ScoredAlignmentPair {
@@ -55,14 +67,7 @@ bool reverse_nam_if_needed(Nam& nam, const Read& read, const References& referen
     std::string ref_start_kmer = references.sequences[nam.ref_id].substr(nam.ref_start, k);
     std::string ref_end_kmer = references.sequences[nam.ref_id].substr(nam.ref_end-k, k);
 
-    std::string seq, seq_rc;
-    if (nam.is_revcomp) {
-        seq = read.rc;
-        seq_rc = read.seq;
-    } else {
-        seq = read.seq;
-        seq_rc = read.rc;
-    }
+    const std::string& seq = nam.is_revcomp ? read.rc() : read.seq;
     std::string read_start_kmer = seq.substr(nam.query_start, k);
     std::string read_end_kmer = seq.substr(nam.query_end-k, k);
     if (ref_start_kmer == read_start_kmer && ref_end_kmer == read_end_kmer) {
@@ -74,6 +79,7 @@ bool reverse_nam_if_needed(Nam& nam, const Read& read, const References& referen
     int q_start_tmp = read_len - nam.query_end;
     int q_end_tmp = read_len - nam.query_start;
     // false reverse hit, change coordinates in nam to forward
+    const std::string& seq_rc = nam.is_revcomp ? read.seq : read.rc();
     read_start_kmer = seq_rc.substr(q_start_tmp, k);
     read_end_kmer = seq_rc.substr(q_end_tmp - k, k);
     if (ref_start_kmer == read_start_kmer && ref_end_kmer == read_end_kmer) {
@@ -85,6 +91,27 @@ bool reverse_nam_if_needed(Nam& nam, const Read& read, const References& referen
     return false;
 }
 
+/*
+ * Prefetch the part of the reference that extend_seed() accesses for the
+ * given NAM (the projected window plus the flanks used for gapped
+ * alignment). Candidate sites are at effectively random reference positions,
+ * so prefetching the windows of all candidates before extending the first
+ * one lets the cache misses overlap instead of stalling on each of them.
+ */
+void prefetch_reference_window(const Nam& nam, const References& references, size_t read_length) {
+    const std::string& ref = references.sequences[nam.ref_id];
+    const size_t start = std::max(0, nam.projected_ref_start() - 50);
+    const size_t end = std::min(nam.ref_end + read_length - nam.query_end + 50, ref.size());
+    if (start >= end) {
+        return;
+    }
+    constexpr uintptr_t cache_line_size = 64;
+    const uintptr_t last = reinterpret_cast<uintptr_t>(ref.data() + end - 1);
+    for (uintptr_t address = reinterpret_cast<uintptr_t>(ref.data() + start) & ~(cache_line_size - 1); address <= last; address += cache_line_size) {
+        __builtin_prefetch(reinterpret_cast<const void*>(address));
+    }
+}
+
 inline void align_single(
     const Aligner& aligner,
     Sam& sam,
@@ -117,13 +144,28 @@ inline void align_single(
     Alignment best_alignment;
     best_alignment.is_unaligned = true;
 
+    // Prefetch the candidates that the loop below may extend
+    for (size_t i = 0; i < nams.size() && i < static_cast<size_t>(max_tries); ++i) {
+        if ((float) nams[i].score() / n_max.score() < dropoff_threshold) {
+            break;
+        }
+        prefetch_reference_window(nams[i], references, read.size());
+    }
+
+    // NAMs at the same locus were merged before, but reverse_nam_if_needed()
+    // may still move a NAM to the locus of one that was already extended
+    std::vector<Nam> extended_nams;
     for (auto &nam : nams) {
-        float score_dropoff = (float) nam.score / n_max.score;
+        float score_dropoff = (float) nam.score() / n_max.score();
         if (tries >= max_tries || (tries > 1 && best_edit_distance == 0) || score_dropoff < dropoff_threshold) {
             break;
         }
         bool consistent_nam = reverse_nam_if_needed(nam, read, references, k);
         details.inconsistent_nams += !consistent_nam;
+        if (std::any_of(extended_nams.begin(), extended_nams.end(), [&](const Nam& other) { return is_same_locus(nam, other, same_locus_tolerance); })) {
+            continue;
+        }
+        extended_nams.push_back(nam);
         auto alignment = extend_seed(aligner, nam, references, read, consistent_nam);
         details.tried_alignment++;
         if (alignment.is_unaligned) {
@@ -173,7 +215,7 @@ inline void align_single(
     details.best_alignments = alignments_with_best_score;
     uint8_t mapq = (60.0 * (best_score - second_best_score) + best_score - 1) / best_score;
     bool is_primary = true;
-    sam.add(best_alignment, record, read.rc, mapq, is_primary, details);
+    sam.add(best_alignment, record, read, mapq, is_primary, details);
 
     if (max_secondary == 0) {
         return;
@@ -204,7 +246,7 @@ inline void align_single(
             break;
         }
         bool is_primary = false;
-        sam.add(alignment, record, read.rc, mapq, is_primary, details);
+        sam.add(alignment, record, read, mapq, is_primary, details);
         n++;
     }
 }
@@ -220,7 +262,7 @@ inline Alignment extend_seed(
     const Read& read,
     bool consistent_nam
 ) {
-    const std::string query = nam.is_revcomp ? read.rc : read.seq;
+    const std::string& query = nam.is_revcomp ? read.rc() : read.seq;
     const std::string& ref = references.sequences[nam.ref_id];
 
     const auto projected_ref_start = nam.projected_ref_start();
@@ -284,8 +326,8 @@ inline uint8_t proper_pair_mapq(const std::vector<Nam> &nams) {
     if (nams.size() <= 1) {
         return 60;
     }
-    const float s1 = nams[0].score;
-    const float s2 = nams[1].score;
+    const float s1 = nams[0].score();
+    const float s2 = nams[1].score();
     // from minimap2: MAPQ = 40(1−s2/s1) ·min{1,|M|/10} · log s1
     const float min_matches = std::min(nams[0].n_matches / 10.0, 1.0);
     const int uncapped_mapq = 40 * (1 - s2 / s1) * min_matches * log(s1);
@@ -382,53 +424,55 @@ inline std::vector<NamPair> get_best_scoring_nam_pairs(
     }
 
     // Find NAM pairs that appear to be proper pairs
-    robin_hood::unordered_set<int> added_n1;
-    robin_hood::unordered_set<int> added_n2;
+    std::vector<bool> added_n1(nams1.size());
+    std::vector<bool> added_n2(nams2.size());
     int best_joint_hits = 0;
-    for (auto &nam1 : nams1) {
-        for (auto &nam2 : nams2) {
+    for (size_t i = 0; i < nams1.size(); ++i) {
+        const Nam& nam1 = nams1[i];
+        for (size_t j = 0; j < nams2.size(); ++j) {
+            const Nam& nam2 = nams2[j];
             int joint_hits = nam1.n_matches + nam2.n_matches;
             if (joint_hits < best_joint_hits / 2) {
                 break;
             }
             if (is_proper_nam_pair(nam1, nam2, mu, sigma)) {
-                nam_pairs.push_back(NamPair{nam1.score + nam2.score, nam1, nam2});
-                added_n1.insert(nam1.nam_id);
-                added_n2.insert(nam2.nam_id);
+                nam_pairs.push_back(NamPair{nam1.score() + nam2.score(), static_cast<int>(i), static_cast<int>(j)});
+                added_n1[i] = true;
+                added_n2[j] = true;
                 best_joint_hits = std::max(joint_hits, best_joint_hits);
             }
         }
     }
 
     // Find high-scoring R1 NAMs that are not part of a proper pair
-    Nam dummy_nam;
-    dummy_nam.ref_start = -1;
     if (!nams1.empty()) {
         int best_joint_hits1 = best_joint_hits > 0 ? best_joint_hits : nams1[0].n_matches;
-        for (auto &nam1 : nams1) {
-            if (nam1.n_matches < best_joint_hits1 / 2) {
+        for (size_t i = 0; i < nams1.size(); ++i) {
+            const Nam& nam1 = nams1[i];
+            if (static_cast<int>(nam1.n_matches) < best_joint_hits1 / 2) {
                 break;
             }
-            if (added_n1.find(nam1.nam_id) != added_n1.end()) {
+            if (added_n1[i]) {
                 continue;
             }
 //            int n1_penalty = std::abs(nam1.query_span() - nam1.ref_span());
-            nam_pairs.push_back(NamPair{nam1.score, nam1, dummy_nam});
+            nam_pairs.push_back(NamPair{nam1.score(), static_cast<int>(i), -1});
         }
     }
 
     // Find high-scoring R2 NAMs that are not part of a proper pair
     if (!nams2.empty()) {
         int best_joint_hits2 = best_joint_hits > 0 ? best_joint_hits : nams2[0].n_matches;
-        for (auto &nam2 : nams2) {
-            if (nam2.n_matches < best_joint_hits2 / 2) {
+        for (size_t j = 0; j < nams2.size(); ++j) {
+            const Nam& nam2 = nams2[j];
+            if (static_cast<int>(nam2.n_matches) < best_joint_hits2 / 2) {
                 break;
             }
-            if (added_n2.find(nam2.nam_id) != added_n2.end()){
+            if (added_n2[j]) {
                 continue;
             }
 //            int n2_penalty = std::abs(nam2.query_span() - nam2.ref_span());
-            nam_pairs.push_back(NamPair{nam2.score, dummy_nam, nam2});
+            nam_pairs.push_back(NamPair{nam2.score(), -1, static_cast<int>(j)});
         }
     }
 
@@ -455,15 +499,14 @@ inline Alignment rescue_align(
 ) {
     Alignment alignment;
     int a, b;
-    std::string r_tmp;
     auto read_len = read.size();
 
+    // mate is rc since fr orientation
+    const std::string& r_tmp = mate_nam.is_revcomp ? read.seq : read.rc();
     if (mate_nam.is_revcomp) {
-        r_tmp = read.seq;
         a = mate_nam.projected_ref_start() - (mu+5*sigma);
         b = mate_nam.projected_ref_start() + read_len/2; // at most half read overlap
     } else {
-        r_tmp = read.rc; // mate is rc since fr orientation
         a = mate_nam.ref_end + (read_len - mate_nam.query_end) - read_len/2; // at most half read overlap
         b = mate_nam.ref_end + (read_len - mate_nam.query_end) + (mu+5*sigma);
     }
@@ -587,6 +630,13 @@ std::vector<ScoredAlignmentPair> rescue_read(
     Nam n_max1 = nams1[0];
     int tries = 0;
 
+    for (size_t i = 0; i < nams1.size() && i < static_cast<size_t>(max_tries); ++i) {
+        if ((float) nams1[i].n_matches / n_max1.n_matches < dropoff) {
+            break;
+        }
+        prefetch_reference_window(nams1[i], references, read1.size());
+    }
+
     std::vector<Alignment> alignments1;
     std::vector<Alignment> alignments2;
     for (auto& nam : nams1) {
@@ -647,7 +697,7 @@ void output_aligned_pairs(
         Alignment alignment1 = best_aln_pair.alignment1;
         Alignment alignment2 = best_aln_pair.alignment2;
 
-        sam.add_pair(alignment1, alignment2, record1, record2, read1.rc, read2.rc, mapq1, mapq2, is_proper_pair(alignment1, alignment2, mu, sigma), true, details);
+        sam.add_pair(alignment1, alignment2, record1, record2, read1, read2, mapq1, mapq2, is_proper_pair(alignment1, alignment2, mu, sigma), true, details);
     } else {
         auto max_out = std::min(high_scores.size(), max_secondary);
         bool is_primary = true;
@@ -664,7 +714,7 @@ void output_aligned_pairs(
             }
             if (s_max - s_score < secondary_dropoff) {
                 bool is_proper = is_proper_pair(alignment1, alignment2, mu, sigma);
-                sam.add_pair(alignment1, alignment2, record1, record2, read1.rc, read2.rc, mapq1, mapq2, is_proper, is_primary, details);
+                sam.add_pair(alignment1, alignment2, record1, record2, read1, read2, mapq1, mapq2, is_proper, is_primary, details);
             } else {
                 break;
             }
@@ -754,6 +804,8 @@ std::vector<ScoredAlignmentPair> align_paired(
     if (top_dropoff(nams1) < dropoff && top_dropoff(nams2) < dropoff && is_proper_nam_pair(nams1[0], nams2[0], mu, sigma)) {
         Nam n_max1 = nams1[0];
         Nam n_max2 = nams2[0];
+        prefetch_reference_window(n_max1, references, read1.size());
+        prefetch_reference_window(n_max2, references, read2.size());
 
         bool consistent_nam1 = reverse_nam_if_needed(n_max1, read1, references, k);
         details[0].inconsistent_nams += !consistent_nam1;
@@ -774,8 +826,20 @@ std::vector<ScoredAlignmentPair> align_paired(
     // Get top hit counts for all locations. The joint hit count is the sum of hits of the two mates. Then align as long as score dropoff or cnt < 20
 
     std::vector<NamPair> nam_pairs = get_best_scoring_nam_pairs(nams1, nams2, mu, sigma);
+    // Prefetch the candidates that are extended below
+    for (size_t i = 0; i < nam_pairs.size() && i < max_tries; ++i) {
+        if (nam_pairs[i].score / nam_pairs[0].score < dropoff) {
+            break;
+        }
+        if (nam_pairs[i].nam1 >= 0) {
+            prefetch_reference_window(nams1[nam_pairs[i].nam1], references, read1.size());
+        }
+        if (nam_pairs[i].nam2 >= 0) {
+            prefetch_reference_window(nams2[nam_pairs[i].nam2], references, read2.size());
+        }
+    }
 
-    // Cache for already computed alignments. Maps NAM ids to alignments.
+    // Cache for already computed alignments. Maps NAM indices to alignments.
     robin_hood::unordered_map<int,Alignment> is_aligned1;
     robin_hood::unordered_map<int,Alignment> is_aligned2;
 
@@ -787,7 +851,7 @@ std::vector<ScoredAlignmentPair> align_paired(
         bool consistent_nam1 = reverse_nam_if_needed(n1_max, read1, references, k);
         details[0].inconsistent_nams += !consistent_nam1;
         a1_indv_max = extend_seed(aligner, n1_max, references, read1, consistent_nam1);
-        is_aligned1[n1_max.nam_id] = a1_indv_max;
+        is_aligned1[0] = a1_indv_max;
         details[0].tried_alignment++;
         details[0].gapped += a1_indv_max.gapped;
 
@@ -795,7 +859,7 @@ std::vector<ScoredAlignmentPair> align_paired(
         bool consistent_nam2 = reverse_nam_if_needed(n2_max, read2, references, k);
         details[1].inconsistent_nams += !consistent_nam2;
         a2_indv_max = extend_seed(aligner, n2_max, references, read2, consistent_nam2);
-        is_aligned2[n2_max.nam_id] = a2_indv_max;
+        is_aligned2[0] = a2_indv_max;
         details[1].tried_alignment++;
         details[1].gapped += a2_indv_max.gapped;
     }
@@ -803,7 +867,7 @@ std::vector<ScoredAlignmentPair> align_paired(
     // Turn pairs of high-scoring NAMs into pairs of alignments
     std::vector<ScoredAlignmentPair> high_scores;
     auto max_score = nam_pairs[0].score;
-    for (auto &[score_, n1, n2] : nam_pairs) {
+    for (auto &[score_, i1, i2] : nam_pairs) {
         float score_dropoff = (float) score_ / max_score;
 
         if (high_scores.size() >= max_tries || score_dropoff < dropoff) {
@@ -813,16 +877,19 @@ std::vector<ScoredAlignmentPair> align_paired(
         // Get alignments for the two NAMs, either by computing the alignment,
         // retrieving it from the cache or by attempting a rescue (if the NAM
         // actually is a dummy, that is, only the partner is available)
+        // Work on copies since reverse_nam_if_needed may modify the NAM
+        Nam n1 = i1 >= 0 ? nams1[i1] : Nam{};
+        Nam n2 = i2 >= 0 ? nams2[i2] : Nam{};
+
         Alignment a1;
-        // ref_start == -1 is a marker for a dummy NAM
-        if (n1.ref_start >= 0) {
-            if (is_aligned1.find(n1.nam_id) != is_aligned1.end() ){
-                a1 = is_aligned1[n1.nam_id];
+        if (i1 >= 0) {
+            if (is_aligned1.find(i1) != is_aligned1.end() ){
+                a1 = is_aligned1[i1];
             } else {
                 bool consistent_nam = reverse_nam_if_needed(n1, read1, references, k);
                 details[0].inconsistent_nams += !consistent_nam;
                 a1 = extend_seed(aligner, n1, references, read1, consistent_nam);
-                is_aligned1[n1.nam_id] = a1;
+                is_aligned1[i1] = a1;
                 details[0].tried_alignment++;
                 details[0].gapped += a1.gapped;
             }
@@ -837,15 +904,14 @@ std::vector<ScoredAlignmentPair> align_paired(
         }
 
         Alignment a2;
-        // ref_start == -1 is a marker for a dummy NAM
-        if (n2.ref_start >= 0) {
-            if (is_aligned2.find(n2.nam_id) != is_aligned2.end() ){
-                a2 = is_aligned2[n2.nam_id];
+        if (i2 >= 0) {
+            if (is_aligned2.find(i2) != is_aligned2.end() ){
+                a2 = is_aligned2[i2];
             } else {
                 bool consistent_nam = reverse_nam_if_needed(n2, read2, references, k);
                 details[1].inconsistent_nams += !consistent_nam;
                 a2 = extend_seed(aligner, n2, references, read2, consistent_nam);
-                is_aligned2[n2.nam_id] = a2;
+                is_aligned2[i2] = a2;
                 details[1].tried_alignment++;
                 details[1].gapped += a2.gapped;
             }
@@ -909,11 +975,11 @@ inline void get_best_map_location(
     // get best joint score
     float score_joint = 0;
     Nam n1_joint_max, n2_joint_max;
-    for (auto &[score, nam1, nam2] : nam_pairs) { // already sorted by descending score
-        if (nam1.ref_start >= 0 && nam2.ref_start >=0) { // Valid pair
-            score_joint = nam1.score + nam2.score;
-            n1_joint_max = nam1;
-            n2_joint_max = nam2;
+    for (auto &[score, i1, i2] : nam_pairs) { // already sorted by descending score
+        if (i1 >= 0 && i2 >= 0) { // Valid pair
+            score_joint = nams1[i1].score() + nams2[i2].score();
+            n1_joint_max = nams1[i1];
+            n2_joint_max = nams2[i2];
             break;
         }
     }
@@ -921,11 +987,11 @@ inline void get_best_map_location(
     // get individual best scores
     float score_indiv = 0;
     if (!nams1.empty()) {
-        score_indiv += nams1[0].score / 2.0; //Penalty for being mapped individually
+        score_indiv += nams1[0].score() / 2.0; //Penalty for being mapped individually
         best_nam1 = nams1[0];
     }
     if (!nams2.empty()) {
-        score_indiv += nams2[0].score / 2.0; //Penalty for being mapped individually
+        score_indiv += nams2[0].score() / 2.0; //Penalty for being mapped individually
         best_nam2 = nams2[0];
     }
     if (score_joint > score_indiv) { // joint score is better than individual
@@ -935,20 +1001,20 @@ inline void get_best_map_location(
         if (output_abundance){
             // we loop twice because we need to count the number of best pairs
             size_t n_best = 0;
-            for (auto &[score, n1, n2] : nam_pairs){
-                if ((n1.score + n2.score) == score_joint){
+            for (auto &[score, i1, i2] : nam_pairs){
+                if (score == score_joint){
                     ++n_best;
                 } else {
                     break;
                 }
             }
-            for (auto &[score, n1, n2] : nam_pairs){
-                if ((n1.score + n2.score) == score_joint){
-                    if (n1.ref_start >= 0) {
-                        abundances[n1.ref_id] += float(read1_len) / float(n_best);
+            for (auto &[score, i1, i2] : nam_pairs){
+                if (score == score_joint){
+                    if (i1 >= 0) {
+                        abundances[nams1[i1].ref_id] += float(read1_len) / float(n_best);
                     }
-                    if (n2.ref_start >= 0) {
-                        abundances[n2.ref_id] += float(read2_len) / float(n_best);
+                    if (i2 >= 0) {
+                        abundances[nams2[i2].ref_id] += float(read2_len) / float(n_best);
                     }
                 } else {
                     break;
@@ -961,7 +1027,7 @@ inline void get_best_map_location(
             size_t best_score = 0;
             // We loop twice because we need to count the number of NAMs with best score
             for (auto &nam : nams) {
-                if (nam.score == nams[0].score){
+                if (nam.score() == nams[0].score()){
                     ++best_score;
                 } else {
                     break;
@@ -971,7 +1037,7 @@ inline void get_best_map_location(
                 if (nam.ref_start < 0) {
                     continue;
                 }
-                if (nam.score != nams[0].score){
+                if (nam.score() != nams[0].score()){
                     break;
                 }
                 abundances[nam.ref_id] += float(read_len) / float(best_score);
@@ -993,8 +1059,8 @@ void shuffle_top_nams(std::vector<Nam>& nams, std::minstd_rand& random_engine) {
     if (nams.empty()) {
         return;
     }
-    auto best_score = nams[0].score;
-    auto it = std::find_if(nams.begin(), nams.end(), [&](const Nam& nam) { return nam.score != best_score; });
+    auto best_score = nams[0].score();
+    auto it = std::find_if(nams.begin(), nams.end(), [&](const Nam& nam) { return nam.score() != best_score; });
     if (it > nams.begin() + 1) {
         std::shuffle(nams.begin(), it, random_engine);
     }
@@ -1019,36 +1085,136 @@ bool has_shared_substring(const std::string& read_seq, const std::string& ref_se
     return false;
 }
 
+/*
+ * Compute the query randstrobes of a read. If a minimum seed quality is set,
+ * randstrobes overlapping low-quality bases are omitted.
+ */
+std::array<std::vector<QueryRandstrobe>, 2> get_randstrobes(
+    const std::string_view seq,
+    const std::string_view qual,
+    const IndexParameters& index_parameters,
+    const MappingParameters& map_param,
+    AlignmentStatistics& statistics
+) {
+    Timer strobe_timer;
+    auto query_randstrobes = randstrobes_query(seq, index_parameters);
+    statistics.n_randstrobes += query_randstrobes[0].size() + query_randstrobes[1].size();
+    statistics.n_low_quality_randstrobes += remove_low_quality_randstrobes(
+        query_randstrobes, qual, map_param.min_seed_quality, index_parameters.syncmer.k
+    );
+    statistics.tot_construct_strobemers += strobe_timer.duration();
+
+    return query_randstrobes;
+}
+
+/*
+ * Check whether the read matches the reference exactly and uniquely by
+ * looking only at its randstrobes. This is the case if
+ * - all randstrobes that are found in the index are found exactly once, in
+ *   the same orientation and on the same diagonal of the same reference, and
+ * - the read is identical to the reference at that diagonal.
+ *
+ * If so, return the end-to-end alignment (the same one that extend_seed()
+ * would compute from the single NAM covering the read).
+ * Return std::nullopt as soon as it becomes clear that the read does not
+ * qualify.
+ */
+std::optional<Alignment> find_exact_match(
+    const std::array<std::vector<QueryRandstrobe>, 2>& query_randstrobes,
+    const StrobemerIndex& index,
+    const References& references,
+    const Read& read,
+    const AlignmentParameters& parameters
+) {
+    int ref_id = -1;
+    int64_t diagonal = 0;
+    bool is_revcomp = false;
+    for (int orientation : {0, 1}) {
+        for (const auto& q : query_randstrobes[orientation]) {
+            size_t position = index.find_full(q.hash);
+            if (position == index.end()) {
+                // Randstrobes near the ends of the read or those covering a
+                // mismatch are not found. The comparison below takes care of
+                // the latter.
+                continue;
+            }
+            if (ref_id != -1 && is_revcomp != (orientation == 1)) {
+                // Hits in both orientations
+                return {};
+            }
+            if (index.get_hash(position + 1) == index.get_hash(position)) {
+                // Repetitive randstrobe
+                return {};
+            }
+            if (static_cast<unsigned int>(index.strobe2_offset(position) + index.k()) != q.end - q.start) {
+                return {};
+            }
+            int64_t q_diagonal = static_cast<int64_t>(index.get_strobe1_position(position)) - q.start;
+            int q_ref_id = index.reference_index(position);
+            if (ref_id == -1) {
+                ref_id = q_ref_id;
+                diagonal = q_diagonal;
+                is_revcomp = orientation == 1;
+            } else if (q_ref_id != ref_id || q_diagonal != diagonal) {
+                return {};
+            }
+        }
+    }
+    if (ref_id == -1) {
+        return {};
+    }
+
+    const std::string& query = is_revcomp ? read.rc() : read.seq;
+    const std::string& ref = references.sequences[ref_id];
+    if (diagonal < 0 || diagonal + query.size() > ref.size()) {
+        return {};
+    }
+    // A single (vectorized) comparison confirms the match
+    if (std::memcmp(query.data(), ref.data() + diagonal, query.size()) != 0) {
+        return {};
+    }
+
+    Alignment alignment;
+    alignment.cigar.push(CIGAR_EQ, query.size());
+    alignment.edit_distance = 0;
+    alignment.global_ed = 0;
+    alignment.score = query.size() * parameters.match + 2 * parameters.end_bonus;
+    alignment.ref_start = diagonal;
+    alignment.length = query.size();
+    alignment.is_revcomp = is_revcomp;
+    alignment.is_unaligned = false;
+    alignment.ref_id = ref_id;
+    alignment.gapped = false;
+
+    return alignment;
+}
+
 /*
  * Obtain NAMs for a sequence record, doing rescue if needed.
  * Return NAMs sorted by decreasing score.
  */
 std::vector<Nam> get_nams(
-    const KSeq& record,
+    [[maybe_unused]] const KSeq& record,
+    const std::array<std::vector<QueryRandstrobe>, 2>& query_randstrobes,
     const StrobemerIndex& index,
     AlignmentStatistics& statistics,
     Details& details,
     const MappingParameters &map_param,
-    const IndexParameters& index_parameters,
     std::minstd_rand& random_engine
 ) {
-    // Compute randstrobes
-    Timer strobe_timer;
-    auto query_randstrobes = randstrobes_query(record.seq, index_parameters);
-    statistics.n_randstrobes += query_randstrobes[0].size() + query_randstrobes[1].size();
-    statistics.tot_construct_strobemers += strobe_timer.duration();
-
     // Find NAMs
     Timer nam_timer;
 
     int total_hits = 0;
     int partial_hits = 0;
     bool sorting_needed = false;
+    std::array<std::vector<RandstrobeLookup>, 2> lookups;
     std::array<std::vector<Hit>, 2> hits;
     for (int is_revcomp : {0, 1}) {
         int total_hits1, partial_hits1;
         bool sorting_needed1;
-        std::tie(total_hits1, partial_hits1, sorting_needed1, hits[is_revcomp]) = find_hits(query_randstrobes[is_revcomp], index, map_param.use_mcs);
+        lookups[is_revcomp] = lookup_randstrobes(query_randstrobes[is_revcomp], index, map_param.use_mcs);
+        std::tie(total_hits1, partial_hits1, sorting_needed1, hits[is_revcomp]) = find_hits(query_randstrobes[is_revcomp], lookups[is_revcomp], index, map_param.use_mcs);
         sorting_needed = sorting_needed || sorting_needed1;
         total_hits += total_hits1;
         partial_hits += partial_hits1;
@@ -1067,7 +1233,7 @@ std::vector<Nam> get_nams(
         int n_rescue_hits{0};
         int n_partial_hits{0};
         for (int is_revcomp : {0, 1}) {
-            auto [n_rescue_hits_oriented, n_partial_hits_oriented, matches_map] = find_matches_rescue(query_randstrobes[is_revcomp], index, map_param.rescue_cutoff, map_param.use_mcs);
+            auto [n_rescue_hits_oriented, n_partial_hits_oriented, matches_map] = find_matches_rescue(query_randstrobes[is_revcomp], lookups[is_revcomp], index, map_param.rescue_cutoff);
             merge_matches_into_nams(matches_map, index.k(), true, is_revcomp, nams);
             n_rescue_hits += n_rescue_hits_oriented;
             n_partial_hits += n_partial_hits_oriented;
@@ -1088,7 +1254,7 @@ std::vector<Nam> get_nams(
 
     // Sort by score
     Timer nam_sort_timer;
-    std::sort(nams.begin(), nams.end(), by_score<Nam>);
+    std::sort(nams.begin(), nams.end(), [](const Nam& a, const Nam& b) { return a.score() > b.score(); });
     shuffle_top_nams(nams, random_engine);
     statistics.tot_sort_nams += nam_sort_timer.duration();
 
@@ -1103,6 +1269,134 @@ std::vector<Nam> get_nams(
     return nams;
 }
 
+/*
+ * Align a read that is longer than what the regular approach can handle.
+ *
+ * The read is split into overlapping segments, and NAMs are found for each
+ * segment separately. The NAMs of all segments are chained and the read is
+ * aligned with a banded aligner along the diagonal given by the chain. The
+ * time needed is linear in the read length.
+ */
+void align_long_read(
+    const Aligner& aligner,
+    Sam& sam,
+    const KSeq& record,
+    AlignmentStatistics& statistics,
+    Details& details,
+    const MappingParameters& map_param,
+    const IndexParameters& index_parameters,
+    const References& references,
+    const StrobemerIndex& index,
+    std::minstd_rand& random_engine
+) {
+    const size_t segment_length = map_param.long_read_segment_length;
+    // Segments overlap so that seeds spanning a segment boundary are not lost
+    const size_t overlap = std::min<size_t>(segment_length / 2, index_parameters.randstrobe.max_dist + 2 * index_parameters.syncmer.k);
+    // Half-width of the band around the chain
+    constexpr int band_width = 50;
+
+    const size_t read_length = record.seq.length();
+    std::vector<Nam> nams;
+    for (size_t start = 0; ; start += segment_length - overlap) {
+        const size_t length = std::min(segment_length, read_length - start);
+        auto segment_randstrobes = get_randstrobes(
+            std::string_view(record.seq).substr(start, length),
+            record.qual.empty() ? std::string_view() : std::string_view(record.qual).substr(start, length),
+            index_parameters,
+            map_param,
+            statistics
+        );
+        auto segment_nams = get_nams(record, segment_randstrobes, index, statistics, details, map_param, random_engine);
+        for (auto& nam : segment_nams) {
+            // Make query coordinates relative to the (reverse-complemented) read
+            int offset = nam.is_revcomp ? read_length - start - length : start;
+            nam.query_start += offset;
+            nam.query_end += offset;
+            nams.push_back(nam);
+        }
+        if (start + length == read_length) {
+            break;
+        }
+    }
+    details.nams = nams.size();
+
+    Chain chain = chain_nams(nams);
+    if (chain.nams.empty()) {
+        sam.add_unmapped(record);
+        return;
+    }
+
+    // Anchor points (query position, reference position) along the chain
+    std::vector<std::pair<int, int>> anchors;
+    for (const auto& nam : chain.nams) {
+        for (auto anchor : {std::make_pair(nam.query_start, nam.ref_start), std::make_pair(nam.query_end, nam.ref_end)}) {
+            if (anchors.empty() || (anchor.first > anchors.back().first && anchor.second >= anchors.back().second)) {
+                anchors.push_back(anchor);
+            }
+        }
+    }
+
+    const bool is_revcomp = chain.nams[0].is_revcomp;
+    const int ref_id = chain.nams[0].ref_id;
+    Read read(record.seq);
+    const std::string& query = is_revcomp ? read.rc() : read.seq;
+    const std::string& ref = references.sequences[ref_id];
+    const int window_start = std::max(0, anchors.front().second - anchors.front().first - band_width);
+    const int window_end = std::min(
+        static_cast<int>(ref.size()),
+        anchors.back().second + static_cast<int>(read_length) - anchors.back().first + band_width
+    );
+
+    // Interpolate the band center between anchors and follow the
+    // diagonal before the first and after the last anchor
+    std::vector<int> band_center(read_length + 1);
+    size_t a = 0;
+    for (size_t i = 0; i <= read_length; i++) {
+        while (a + 1 < anchors.size() && anchors[a + 1].first <= static_cast<int>(i)) {
+            a++;
+        }
+        auto [q1, r1] = anchors[a];
+        int center;
+        if (static_cast<int>(i) <= q1 || a + 1 == anchors.size()) {
+            center = r1 + (static_cast<int>(i) - q1);
+        } else {
+            auto [q2, r2] = anchors[a + 1];
+            center = r1 + static_cast<int64_t>(r2 - r1) * (static_cast<int>(i) - q1) / (q2 - q1);
+        }
+        band_center[i] = center - window_start;
+    }
+
+    auto info = banded_align(query, ref.substr(window_start, window_end - window_start), band_center, band_width, aligner.parameters);
+    details.tried_alignment++;
+    details.gapped++;
+    if (info.sw_score == 0) {
+        sam.add_unmapped(record);
+        return;
+    }
+
+    Alignment alignment;
+    int softclipped = info.query_start + (query.size() - info.query_end);
+    alignment.cigar = std::move(info.cigar);
+    alignment.edit_distance = info.edit_distance;
+    alignment.global_ed = info.edit_distance + softclipped;
+    alignment.score = info.sw_score;
+    alignment.ref_start = window_start + info.ref_start;
+    alignment.length = info.ref_span();
+    alignment.is_revcomp = is_revcomp;
+    alignment.is_unaligned = false;
+    alignment.ref_id = ref_id;
+    alignment.gapped = true;
+
+    // Same as in align_single(), but using chain scores
+    float best = chain.score;
+    float second = std::min(chain.second_best_score, best);
+    uint8_t mapq = std::min(60.0f, (60.0f * (best - second) + best - 1) / best);
+    details.best_alignments = 1;
+    bool is_primary = true;
+    sam.add(alignment, record, read, mapq, is_primary, details);
+    statistics.n_long_reads++;
+}
+
 void align_or_map_paired(
     const KSeq &record1,
     const KSeq &record2,
@@ -1126,7 +1420,8 @@ void align_or_map_paired(
 #ifdef TRACE
         std::cerr << "R" << is_r1 + 1 << '\n';
 #endif
-        nams_pair[is_r1] = get_nams(record, index, statistics, details[is_r1], map_param, index_parameters, random_engine);
+        auto query_randstrobes = get_randstrobes(record.seq, record.qual, index_parameters, map_param, statistics);
+        nams_pair[is_r1] = get_nams(record, query_randstrobes, index, statistics, details[is_r1], map_param, random_engine);
     }
 
     Timer extend_timer;
@@ -1149,6 +1444,9 @@ void align_or_map_paired(
                             record2.seq.length());
         }
     } else {
+        for (auto& nams : nams_pair) {
+            statistics.n_merged_nams += merge_nams_at_same_locus(nams, same_locus_tolerance, map_param.dropoff_threshold);
+        }
         Read read1(record1.seq);
         Read read2(record2.seq);
         auto alignment_pairs = align_paired(
@@ -1178,7 +1476,7 @@ void align_or_map_paired(
             details[0].best_alignments = 1;
             details[1].best_alignments = 1;
             bool is_primary = true;
-            sam.add_pair(alignment1, alignment2, record1, record2, read1.rc, read2.rc, mapq1, mapq2, is_proper, is_primary, details);
+            sam.add_pair(alignment1, alignment2, record1, record2, read1, read2, mapq1, mapq2, is_proper, is_primary, details);
         } else {
             std::sort(alignment_pairs.begin(), alignment_pairs.end(), by_score<ScoredAlignmentPair>);
             deduplicate_scored_pairs(alignment_pairs);
@@ -1231,7 +1529,42 @@ void align_or_map_single(
     std::vector<double> &abundances
 ) {
     Details details;
-    std::vector<Nam> nams = get_nams(record, index, statistics, details, map_param, index_parameters, random_engine);
+    if (
+        map_param.output_format == OutputFormat::SAM
+        && map_param.long_reads
+        && record.seq.length() > map_param.long_read_segment_length
+    ) {
+        Timer extend_timer;
+        align_long_read(aligner, sam, record, statistics, details, map_param, index_parameters, references, index, random_engine);
+        statistics.tot_extend += extend_timer.duration();
+        statistics += details;
+        return;
+    }
+
+    auto query_randstrobes = get_randstrobes(record.seq, record.qual, index_parameters, map_param, statistics);
+
+    // The fast path reports a single primary alignment with MAPQ 60 and
+    // no details, so it is not used when secondary alignments or details
+    // are requested
+    if (
+        map_param.exact_fast_path
+        && map_param.output_format == OutputFormat::SAM
+        && map_param.max_secondary == 0
+        && !map_param.details
+    ) {
+        Timer exact_timer;
+        Read read(record.seq);
+        auto alignment = find_exact_match(query_randstrobes, index, references, read, aligner.parameters);
+        statistics.tot_exact_match += exact_timer.duration();
+        if (alignment) {
+            details.best_alignments = 1;
+            sam.add(*alignment, record, read, 60, true, details);
+            statistics.n_exact_matches++;
+            return;
+        }
+    }
+
+    std::vector<Nam> nams = get_nams(record, query_randstrobes, index, statistics, details, map_param, random_engine);
 
     Timer extend_timer;
     size_t n_best = 0;
@@ -1239,7 +1572,7 @@ void align_or_map_single(
         case OutputFormat::Abundance: {
             if (!nams.empty()){
                 for (auto &t : nams){
-                    if (t.score == nams[0].score){
+                    if (t.score() == nams[0].score()){
                         ++n_best;
                     }else{
                         break;
@@ -1250,7 +1583,7 @@ void align_or_map_single(
                     if (nam.ref_start < 0) {
                         continue;
                     }
-                    if (nam.score != nams[0].score){
+                    if (nam.score() != nams[0].score()){
                         break;
                     }
                     abundances[nam.ref_id] += float(record.seq.length()) / float(n_best);
@@ -1263,6 +1596,7 @@ void align_or_map_single(
                             record.seq.length());
             break;
         case OutputFormat::SAM:
+            statistics.n_merged_nams += merge_nams_at_same_locus(nams, same_locus_tolerance, map_param.dropoff_threshold);
             align_single(
                 aligner, sam, nams, record, index_parameters.syncmer.k,
                 references, details, map_param.dropoff_threshold, map_param.max_tries,
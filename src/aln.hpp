@@ -26,7 +26,13 @@ struct MappingParameters {
     int rescue_level { 2 };
     int max_tries { 20 };
     int rescue_cutoff;
-    bool use_mcs{false};  // multi-context seeds
+    bool use_mcs{true};  // multi-context seeds
+    bool exact_fast_path{false};
+    bool long_reads{false};
+    // In long-read mode, single-end reads longer than this are aligned in segments
+    size_t long_read_segment_length{500};
+    // Randstrobes overlapping bases with a lower base quality are not looked up
+    int min_seed_quality{0};
     OutputFormat output_format {OutputFormat::SAM};
     CigarOps cigar_ops{CigarOps::M};
     bool output_unmapped { true };
@@ -37,6 +43,9 @@ struct MappingParameters {
         if (max_tries < 1) {
             throw BadParameter("max_tries must be greater than zero");
         }
+        if (min_seed_quality < 0 || min_seed_quality > 93) {
+            throw BadParameter("Minimum seed quality must be between 0 and 93");
+        }
     }
 };
 
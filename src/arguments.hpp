@@ -27,10 +27,13 @@ struct SeedingArguments {
         , bits{parser, "INT", "No. of top bits of hash to use as bucket indices (8-31)"
             "[determined from reference size]", {'b'}}
         , aux_len{parser, "INT", "No. of bits to use from secondary strobe hash [17]", {"aux-len"}}
+        , hash{parser, "STR", "Hash function for syncmers: 'xxh64' or 'mx' (multiply-xorshift, faster). "
+            "An index created with one cannot be used with the other [xxh64]", {"hash"}}
     {
     }
     args::ArgumentParser& parser;
     args::ValueFlag<int> r, m, k, l, u, c, s, bits, aux_len;
+    args::ValueFlag<std::string> hash;
 };
 
 #endif
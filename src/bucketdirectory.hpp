@@ -0,0 +1,124 @@
+#ifndef STROBEALIGN_BUCKETDIRECTORY_HPP
+#define STROBEALIGN_BUCKETDIRECTORY_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <stdexcept>
+#include <iostream>
+#include "io.hpp"
+#include "exceptions.hpp"
+#include "randstrobes.hpp"
+
+/*
+ * Directory that maps each of the 2^bits buckets (the top *bits* bits of a
+ * randstrobe hash) to the index of the first entry in the sorted randstrobes
+ * vector whose bucket is greater than or equal to it. There is one extra
+ * guard entry at the end that is always the size of the randstrobes vector.
+ *
+ * The start indices are stored as 32-bit offsets, which halves the size of
+ * the directory compared to 64-bit indices. If there are more than 2^32 - 1
+ * randstrobes, the offsets are relative to a 64-bit base for each superblock
+ * of 2^SUPERBLOCK_BITS consecutive buckets. (The bases are not used
+ * otherwise because the additional load measurably slows down lookups.)
+ */
+class BucketDirectory {
+public:
+    static constexpr int SUPERBLOCK_BITS = 16;
+
+    uint64_t operator[](size_t bucket) const {
+        if (bases.empty()) {
+            return offsets[bucket];
+        }
+        return bases[bucket >> SUPERBLOCK_BITS] + offsets[bucket];
+    }
+
+    /* Number of entries (including the guard entry) */
+    size_t size() const {
+        return offsets.size();
+    }
+
+    void clear() {
+        bases.clear();
+        offsets.clear();
+    }
+
+    size_t memory_usage() const {
+        return bases.size() * sizeof(uint64_t) + offsets.size() * sizeof(uint32_t);
+    }
+
+    /* Fill the directory for the given sorted randstrobes vector */
+    void build(int bits, const std::vector<RefRandstrobe>& randstrobes, size_t n_threads) {
+        const size_t n_buckets = size_t{1} << bits;
+        const size_t n_superblocks = (n_buckets >> SUPERBLOCK_BITS) + 1;
+        auto bucket_of = [bits](const RefRandstrobe& randstrobe) -> size_t {
+            return randstrobe.hash() >> (64 - bits);
+        };
+        std::vector<uint64_t> superblock_starts(n_superblocks);
+        for (size_t superblock = 0; superblock < n_superblocks; ++superblock) {
+            const size_t bucket = superblock << SUPERBLOCK_BITS;
+            superblock_starts[superblock] = std::partition_point(
+                randstrobes.begin(), randstrobes.end(),
+                [&](const RefRandstrobe& randstrobe) { return bucket_of(randstrobe) < bucket; }
+            ) - randstrobes.begin();
+        }
+        const bool use_bases = randstrobes.size() > UINT32_MAX;
+        offsets.resize(n_buckets + 1);
+
+        // The superblocks are independent of each other
+        auto fill = [&](size_t first_superblock, size_t last_superblock) {
+            for (size_t superblock = first_superblock; superblock < last_superblock; ++superblock) {
+                const size_t first_bucket = superblock << SUPERBLOCK_BITS;
+                const size_t last_bucket = std::min(first_bucket + (size_t{1} << SUPERBLOCK_BITS), n_buckets + 1);
+                const uint64_t base = use_bases ? superblock_starts[superblock] : 0;
+                size_t position = superblock_starts[superblock];
+                for (size_t bucket = first_bucket; bucket < last_bucket; ++bucket) {
+                    while (position < randstrobes.size() && bucket_of(randstrobes[position]) < bucket) {
+                        ++position;
+                    }
+                    offsets[bucket] = offset(position, base);
+                }
+            }
+        };
+        n_threads = std::clamp<size_t>(n_threads, 1, n_superblocks);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < n_threads; ++i) {
+            workers.push_back(std::thread(fill, n_superblocks * i / n_threads, n_superblocks * (i + 1) / n_threads));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        if (use_bases) {
+            bases = std::move(superblock_starts);
+        } else {
+            bases.clear();
+        }
+    }
+
+    void write(std::ostream& os) const {
+        write_vector(os, bases);
+        write_vector(os, offsets);
+    }
+
+    void read(std::istream& is) {
+        read_vector(is, bases);
+        read_vector(is, offsets);
+        if (offsets.empty() || (!bases.empty() && bases.size() != ((offsets.size() - 1) >> SUPERBLOCK_BITS) + 1)) {
+            throw InvalidIndexFile("Bucket directory has an inconsistent size");
+        }
+    }
+
+private:
+    static uint32_t offset(uint64_t position, uint64_t base) {
+        if (position - base > UINT32_MAX) {
+            throw std::range_error("Too many randstrobes in a bucket directory superblock");
+        }
+        return position - base;
+    }
+
+    std::vector<uint64_t> bases;
+    std::vector<uint32_t> offsets;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "checkpoint.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "exceptions.hpp"
+#include "io.hpp"
+
+namespace {
+
+const uint32_t CHECKPOINT_FILE_FORMAT_VERSION = 1;
+
+static_assert(std::is_trivially_copyable_v<AlignmentStatistics>);
+
+}
+
+void Checkpoint::write(const std::string& path) const {
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream ofs(tmp_path, std::ios::binary);
+        if (!ofs.is_open()) {
+            throw InvalidFile(tmp_path + ": " + strerror(errno));
+        }
+        ofs.write("STC\1", 4); // Magic number
+        write_int_to_ostream(ofs, CHECKPOINT_FILE_FORMAT_VERSION);
+        write_vector(ofs, std::vector<char>(arguments.begin(), arguments.end()));
+        write_uint64_to_ostream(ofs, n_chunks);
+        write_uint64_to_ostream(ofs, output_size);
+        write_uint64_to_ostream(ofs, sizeof(statistics));
+        ofs.write(reinterpret_cast<const char*>(&statistics), sizeof(statistics));
+        write_vector(ofs, abundances);
+        ofs.close();
+        if (ofs.fail()) {
+            throw InvalidFile("Could not write checkpoint file " + tmp_path);
+        }
+    }
+    // Renaming is atomic, so the checkpoint file is always complete
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        throw InvalidFile("Could not rename " + tmp_path + " to " + path + ": " + strerror(errno));
+    }
+}
+
+std::optional<Checkpoint> Checkpoint::read(const std::string& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open()) {
+        return {};
+    }
+    char magic[4];
+    ifs.read(magic, 4);
+    if (!ifs || std::memcmp(magic, "STC\1", 4) != 0) {
+        throw InvalidFile(path + ": Not a checkpoint file");
+    }
+    if (static_cast<uint32_t>(read_int_from_istream(ifs)) != CHECKPOINT_FILE_FORMAT_VERSION) {
+        throw InvalidFile(path + ": Checkpoint was written by an incompatible version of strobealign");
+    }
+    Checkpoint checkpoint;
+    std::vector<char> arguments;
+    read_vector(ifs, arguments);
+    checkpoint.arguments = std::string(arguments.begin(), arguments.end());
+    checkpoint.n_chunks = read_uint64_from_istream(ifs);
+    checkpoint.output_size = read_uint64_from_istream(ifs);
+    if (read_uint64_from_istream(ifs) != sizeof(checkpoint.statistics)) {
+        throw InvalidFile(path + ": Checkpoint was written by an incompatible version of strobealign");
+    }
+    ifs.read(reinterpret_cast<char*>(&checkpoint.statistics), sizeof(checkpoint.statistics));
+    read_vector(ifs, checkpoint.abundances);
+    if (!ifs) {
+        throw InvalidFile(path + ": Checkpoint file is truncated");
+    }
+    return checkpoint;
+}
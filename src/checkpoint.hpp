@@ -0,0 +1,33 @@
+#ifndef STROBEALIGN_CHECKPOINT_HPP
+#define STROBEALIGN_CHECKPOINT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "statistics.hpp"
+
+/*
+ * Progress of a mapping run, which is periodically written to disk so that
+ * an interrupted run can be resumed.
+ *
+ * The output of the first n_chunks chunks of reads is complete and takes up
+ * the first output_size bytes of the output file. Statistics and abundances
+ * are those accumulated over these chunks.
+ */
+struct Checkpoint {
+    std::string arguments;  // Command line of the run that wrote the checkpoint
+    uint64_t n_chunks{0};
+    uint64_t output_size{0};
+    AlignmentStatistics statistics;
+    std::vector<double> abundances;
+
+    /* Write to a temporary file that is then renamed to path */
+    void write(const std::string& path) const;
+
+    /* Return an empty optional if the file does not exist */
+    static std::optional<Checkpoint> read(const std::string& path);
+};
+
+#endif
@@ -1,11 +1,38 @@
 #include "cmdline.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <args.hxx>
 #include "arguments.hpp"
 #include "version.hpp"
 
 class Version {};
 
+/*
+ * Parse a shard specification "i/N" (1 <= i <= N) and return the 0-based
+ * shard index and N. Return {0, 0} if the specification is invalid.
+ */
+std::pair<size_t, size_t> parse_shard(const std::string& spec) {
+    auto slash = spec.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 == spec.size()) {
+        return {0, 0};
+    }
+    auto part = spec.substr(0, slash);
+    auto total = spec.substr(slash + 1);
+    auto is_number = [](const std::string& s) {
+        return s.size() <= 9 && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); });
+    };
+    if (!is_number(part) || !is_number(total)) {
+        return {0, 0};
+    }
+    size_t i = std::stoul(part);
+    size_t n = std::stoul(total);
+    if (i < 1 || i > n) {
+        return {0, 0};
+    }
+    return {i - 1, n};
+}
+
 CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
 
     args::ArgumentParser parser("strobealign " + version_string());
@@ -21,6 +48,7 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     // Threading
     args::ValueFlag<int> threads(parser, "INT", "Number of threads [1]", {'t', "threads"});
     args::ValueFlag<int> chunk_size(parser, "INT", "Number of reads processed by a worker thread at once [10000]", {"chunk-size"}, args::Options::Hidden);
+    args::ValueFlag<std::string> simd(parser, "STR", "Use at most this SIMD instruction set: baseline, sse4.1, avx2 or avx512 [best supported by the CPU]", {"simd"}, args::Options::Hidden);
 
     args::Group io(parser, "Input/output:");
     args::ValueFlag<std::string> o(parser, "PATH", "redirect output to file [stdout]", {'o'});
@@ -32,6 +60,11 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     args::ValueFlag<std::string> index_statistics(parser, "PATH", "Print statistics of indexing to PATH", {"index-statistics"});
     args::Flag i(parser, "index", "Do not map reads; only generate the strobemer index and write it to disk. If read files are provided, they are used to estimate read length", {"create-index", 'i'});
     args::Flag use_index(parser, "use_index", "Use a pre-generated index previously written with --create-index.", { "use-index" });
+    args::ValueFlag<std::string> checkpoint(parser, "PATH", "Periodically record progress in PATH. If PATH exists, resume the interrupted run that wrote it (requires -o and the same arguments)", {"checkpoint"});
+    args::ValueFlag<int> checkpoint_interval(parser, "INT", "Seconds between checkpoints [60]", {"checkpoint-interval"});
+    args::ValueFlag<std::string> shard(parser, "i/N", "Split the reads into N shards (by chunks of --chunk-size reads or pairs) and only process shard i (1 <= i <= N). The outputs of the N shards together contain the same records as the output of a single run", {"shard"});
+    args::ValueFlag<int> max_batch_delay(parser, "INT", "Low-latency mode: Map a partial chunk of reads once its first read has waited INT milliseconds, and write each chunk of output as soon as it is ready (not in input order). Reads from pipes are processed as they arrive [0 (disabled)]", {"max-batch-delay"});
+    args::ValueFlag<std::string> index_layout(parser, "STR", "How the index is searched: 'buckets' (sorted array with bucket directory) or 'hashtable' (open-addressing hash table). Ignored with --use-index [buckets]", {"index-layout"});
 
     args::Group sam(parser, "SAM output:");
     args::Flag eqx(parser, "eqx", "Emit =/X instead of M CIGAR operations", {"eqx"});
@@ -54,7 +87,11 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     args::ValueFlag<int> end_bonus(parser, "INT", "Soft clipping penalty [10]", {'L'});
 
     args::Group search(parser, "Search parameters:");
-    args::Flag mcs(parser, "mcs", "Use extended multi-context seed mode for finding hits. Slightly more accurate, but slower", {"mcs"});
+    args::Flag mcs(parser, "mcs", "Use extended multi-context seed mode for finding hits: Look up the partial seed whenever a full seed is not found (default)", {"mcs"});
+    args::Flag no_mcs(parser, "no-mcs", "Look up partial seeds only if no full seeds were found at all. Slightly faster, but less accurate", {"no-mcs"});
+    args::Flag long_reads(parser, "long-reads", "Align single-end reads longer than 500 bp by chaining the NAMs of overlapping segments and using banded alignment (SAM output only)", {"long-reads"});
+    args::Flag exact_fast_path(parser, "exact-fast-path", "Output single-end reads that match the reference exactly and uniquely without computing NAMs and alignments (with MAPQ 60). Ignored with -N and --details", {"exact-fast-path"});
+    args::ValueFlag<int> min_seed_quality(parser, "INT", "Do not look up randstrobes that overlap bases with a base quality below INT [0]", {"min-seed-quality"});
     args::ValueFlag<float> f(parser, "FLOAT", "Top fraction of repetitive strobemers to filter out from sampling [0.0002]", {'f'});
     args::ValueFlag<float> S(parser, "FLOAT", "Try candidate sites with mapping score at least S of maximum mapping score [0.5]", {'S'});
     args::ValueFlag<int> M(parser, "INT", "Maximum number of mapping sites to try [20]", {'M'});
@@ -90,6 +127,7 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     // Threading
     if (threads) { opt.n_threads = args::get(threads); }
     if (chunk_size) { opt.chunk_size = args::get(chunk_size); }
+    if (simd) { opt.simd = args::get(simd); }
 
     // Input/output
     if (o) { opt.output_file_name = args::get(o); opt.write_to_stdout = false; }
@@ -99,6 +137,19 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     if (index_statistics) { opt.logfile_name = args::get(index_statistics); }
     if (i) { opt.only_gen_index = true; }
     if (use_index) { opt.use_index = true; }
+    if (index_layout) { opt.index_layout = args::get(index_layout); }
+    if (checkpoint) { opt.checkpoint_file_name = args::get(checkpoint); }
+    if (checkpoint_interval) { opt.checkpoint_interval = args::get(checkpoint_interval); }
+    if (shard) {
+        auto [shard_index, n_shards] = parse_shard(args::get(shard));
+        if (n_shards == 0) {
+            std::cerr << "Error: --shard must be given as i/N with 1 <= i <= N" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        opt.shard_index = shard_index;
+        opt.n_shards = n_shards;
+    }
+    if (max_batch_delay) { opt.max_batch_delay = args::get(max_batch_delay); }
     if (aemb) {opt.is_abundance_out = true; }
 
     // SAM output
@@ -121,6 +172,7 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     if (seeding.c) { opt.c = args::get(seeding.c); opt.c_set = true; }
     if (seeding.bits) { opt.bits = args::get(seeding.bits); }
     if (seeding.aux_len) { opt.aux_len = args::get(seeding.aux_len); }
+    if (seeding.hash) { opt.hash = args::get(seeding.hash); }
 
     // Alignment
     // if (n) { n = args::get(n); }
@@ -131,7 +183,11 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
     if (end_bonus) { opt.end_bonus = args::get(end_bonus); }
 
     // Search parameters
-    if (mcs) { opt.mcs = args::get(mcs); }
+    if (mcs) { opt.mcs = true; }
+    if (no_mcs) { opt.mcs = false; }
+    if (exact_fast_path) { opt.exact_fast_path = true; }
+    if (long_reads) { opt.long_reads = true; }
+    if (min_seed_quality) { opt.min_seed_quality = args::get(min_seed_quality); }
     if (f) { opt.f = args::get(f); }
     if (S) { opt.dropoff_threshold = args::get(S); }
     if (M) { opt.max_tries = args::get(M); }
@@ -152,10 +208,30 @@ CommandLineOptions parse_command_line_arguments(int argc, char **argv) {
         opt.is_SE = true;
     }
 
+    if (mcs && no_mcs) {
+        std::cerr << "Error: Options --mcs and --no-mcs cannot be used at the same time" << std::endl;
+        exit(EXIT_FAILURE);
+    }
     if (opt.use_index && opt.only_gen_index) {
         std::cerr << "Error: Options -i and --use-index cannot be used at the same time" << std::endl;
         exit(EXIT_FAILURE);
     }
+    if (!opt.checkpoint_file_name.empty() && (opt.write_to_stdout || opt.only_gen_index)) {
+        std::cerr << "Error: Option --checkpoint requires -o and cannot be used with -i" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (opt.checkpoint_interval < 0) {
+        std::cerr << "Error: Checkpoint interval must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (opt.max_batch_delay < 0) {
+        std::cerr << "Error: Maximum batch delay must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (opt.max_batch_delay > 0 && (!opt.checkpoint_file_name.empty() || opt.is_interleaved || opt.n_shards > 1)) {
+        std::cerr << "Error: Option --max-batch-delay cannot be used with --checkpoint, --interleaved or --shard" << std::endl;
+        exit(EXIT_FAILURE);
+    }
     if (opt.reads_filename1.empty() && !opt.only_gen_index) {
         std::cerr << "Error: At least one file with reads must be specified." << std::endl;
         exit(EXIT_FAILURE);
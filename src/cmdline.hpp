@@ -14,6 +14,7 @@ struct CommandLineOptions {
         10000
 #endif
     };
+    std::string simd;  // empty: use the best SIMD level the CPU supports
 
     // Input/output
     std::string output_file_name;
@@ -23,6 +24,12 @@ struct CommandLineOptions {
     std::string logfile_name { "" };
     bool only_gen_index { false };
     bool use_index { false };
+    std::string index_layout { "buckets" };
+    std::string checkpoint_file_name;
+    int checkpoint_interval { 60 };
+    size_t shard_index { 0 };  // 0-based
+    size_t n_shards { 1 };
+    int max_batch_delay { 0 };  // milliseconds; 0 disables low-latency mode
     bool is_sam_out { true };
     bool is_abundance_out {false};
 
@@ -53,6 +60,7 @@ struct CommandLineOptions {
     int s { 16 };
     int c { 8 };
     int aux_len{17};
+    std::string hash{"xxh64"};
 
     // Alignment
     int A { 2 };
@@ -62,7 +70,10 @@ struct CommandLineOptions {
     int end_bonus { 10 };
 
     // Search parameters
-    bool mcs { false };
+    bool mcs { true };
+    bool exact_fast_path { false };
+    bool long_reads { false };
+    int min_seed_quality { 0 };
     float f { 0.0002 };
     float dropoff_threshold { 0.5 };
     int max_tries { 20 };
@@ -77,5 +88,6 @@ struct CommandLineOptions {
 };
 
 CommandLineOptions parse_command_line_arguments(int argc, char **argv);
+std::pair<size_t, size_t> parse_shard(const std::string& spec);
 
 #endif
@@ -103,6 +103,7 @@ int run_dumpstrobes(int argc, char **argv) {
     // Seeding
     int r{150}, k{20}, s{16}, c{8}, l{1}, u{7}, aux_len{17};
     int max_seed_len{};
+    std::string hash{"xxh64"};
 
     bool k_set{false}, s_set{false}, c_set{false}, max_seed_len_set{false}, l_set{false}, u_set{false};
     if (seeding.r) { r = args::get(seeding.r); }
@@ -112,6 +113,7 @@ int run_dumpstrobes(int argc, char **argv) {
     if (seeding.u) { u = args::get(seeding.u); u_set = true; }
     if (seeding.s) { s = args::get(seeding.s); s_set = true; }
     if (seeding.c) { c = args::get(seeding.c); c_set = true; }
+    if (seeding.hash) { hash = args::get(seeding.hash); }
 
     // Reference
     auto ref_path = args::get(ref_filename);
@@ -126,7 +128,8 @@ int run_dumpstrobes(int argc, char **argv) {
         u_set ? u : IndexParameters::DEFAULT,
         c_set ? c : IndexParameters::DEFAULT,
         max_seed_len_set ? max_seed_len : IndexParameters::DEFAULT,
-        aux_len ? aux_len : IndexParameters::DEFAULT
+        aux_len ? aux_len : IndexParameters::DEFAULT,
+        syncmer_hash_from_string(hash)
     );
 
     logger.info() << index_parameters << '\n';
@@ -1,4 +1,5 @@
 #include "fastq.hpp"
+#include <sys/stat.h>
 
 namespace {
     bool check_ext(const std::string& filename, const std::string& target_ext)
@@ -20,10 +21,21 @@ namespace {
         return check_ext(filename, ".gz");
     }
 
+    // Return whether the file is stdin, a pipe or another non-regular file
+    bool is_stream(const std::string& filename)
+    {
+        struct stat st;
+        return filename == "/dev/stdin" || (stat(filename.c_str(), &st) == 0 && !S_ISREG(st.st_mode));
+    }
+
     std::unique_ptr<Reader> make_reader(const std::string& filename)
     {
         std::unique_ptr<Reader> io;
-        if(is_gzip(filename)) {
+        if (is_stream(filename)) {
+            // Cannot be memory-mapped. Returns data as it arrives and
+            // decompresses it if it is gzip-compressed.
+            io = std::make_unique<StreamReader>(filename);
+        } else if(is_gzip(filename)) {
             io = std::make_unique<IsalGzipReader>(filename);
         } else {
             io = std::make_unique<UncompressedReader>(filename);
@@ -46,6 +58,12 @@ RewindableFile::~RewindableFile() {
 }
 
 void RewindableFile::rewind() {
+    if (exceeded_saved_size) {
+        throw std::runtime_error(
+            "Cannot rewind input file because more than " + std::to_string(max_saved_size >> 20)
+            + " MiB were read from it (specify the read length with -r to avoid this)"
+        );
+    }
     if (!rewindable) {
         throw std::runtime_error("Cannot rewind non-rewindable file");
     }
@@ -74,9 +92,19 @@ int RewindableFile::read(void* buffer, const int length) {
         throw std::runtime_error("Error reading FASTQ file");
     }
     if (rewindable) {
-        saved_buffer.push_back(std::vector<unsigned char>(
-                    static_cast<unsigned char*>(buffer),
-                    static_cast<unsigned char*>(buffer) + bytes_read));
+        if (saved_size + bytes_read > max_saved_size) {
+            // Too much was read to be replayed. Give up on rewinding
+            // instead of keeping the entire input in memory.
+            saved_buffer.clear();
+            saved_buffer.shrink_to_fit();
+            rewindable = false;
+            exceeded_saved_size = true;
+        } else {
+            saved_buffer.push_back(std::vector<unsigned char>(
+                        static_cast<unsigned char*>(buffer),
+                        static_cast<unsigned char*>(buffer) + bytes_read));
+            saved_size += bytes_read;
+        }
     }
     return bytes_read;
 }
@@ -10,6 +10,10 @@
 #include "iowrap.hpp"
 
 // File that can be rewound (once only!)
+//
+// Everything read before rewinding is kept in memory and replayed
+// afterwards, which also works for pipes and stdin. At most max_saved_size
+// bytes are kept; reading more makes the file non-rewindable.
 class RewindableFile {
 
 public:
@@ -26,9 +30,12 @@ public:
 
 protected:
     std::unique_ptr<Reader> reader;
+    static constexpr size_t max_saved_size = 64ull * 1024 * 1024;
     std::vector<std::vector<unsigned char>> saved_buffer;
+    size_t saved_size{0};
     // if rewindable is false, the file cannot be rewound anymore and is consuming from saved_buffer (if it is not empty)
     bool rewindable;
+    bool exceeded_saved_size{false};
     stream_type stream_;
 };
 
@@ -117,4 +117,15 @@ uint64_t xxh64(uint64_t input) {
     return result;
 }
 
+/*
+ * A cheaper alternative to xxh64(): One multiplication followed by a single
+ * xorshift. Both steps are invertible, so distinct inputs (k-mers) never
+ * collide. The additive constant ensures that the all-zero input (a
+ * poly-A k-mer) does not hash to zero.
+ */
+static inline uint64_t multiply_xorshift(uint64_t input) {
+    uint64_t result = (input + XXH_PRIME64_5) * XXH_PRIME64_1;
+    return result ^ (result >> 32);
+}
+
 #endif
@@ -0,0 +1,95 @@
+#ifndef STROBEALIGN_HASHTABLE_HPP
+#define STROBEALIGN_HASHTABLE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <iostream>
+#include "io.hpp"
+
+/*
+ * Open-addressing hash table that maps a (masked) randstrobe hash to the
+ * position of its first occurrence in the sorted randstrobes vector.
+ *
+ * Since all occurrences of a hash are stored contiguously in the randstrobes
+ * vector, a single position suffices to describe the whole run.
+ *
+ * The slot for a key is chosen from the top bits of the key (the hash values
+ * are already uniformly distributed) and collisions are resolved by linear
+ * probing. Key and position are stored next to each other, so a lookup
+ * usually touches only a single cache line.
+ *
+ * Because the slot index is monotone in the key, inserting keys in sorted
+ * order (as they appear in the randstrobes vector) keeps probe sequences
+ * short and writes the table front to back.
+ */
+class RandstrobeHashTable {
+public:
+    struct Slot {
+        uint64_t key;
+        uint64_t position;
+    };
+
+    // Randstrobe hashes always have their lowest eight bits cleared, so
+    // this cannot be a valid key
+    static constexpr uint64_t EMPTY = ~0ull;
+    static constexpr uint64_t NOT_FOUND = ~0ull;
+
+    /* Allocate enough slots for n_keys keys at a load factor of about 2/3 */
+    void reset(size_t n_keys) {
+        slots.assign(n_keys + n_keys / 2 + 1, Slot{EMPTY, 0});
+    }
+
+    /* Insert a key that is not yet in the table */
+    void insert(uint64_t key, uint64_t position) {
+        size_t i = slot_index(key);
+        while (slots[i].key != EMPTY) {
+            if (++i == slots.size()) {
+                i = 0;
+            }
+        }
+        slots[i] = Slot{key, position};
+    }
+
+    /* Return the position stored for the key or NOT_FOUND */
+    uint64_t find(uint64_t key) const {
+        size_t i = slot_index(key);
+        while (true) {
+            const Slot& slot = slots[i];
+            if (slot.key == key) {
+                return slot.position;
+            }
+            if (slot.key == EMPTY) {
+                return NOT_FOUND;
+            }
+            if (++i == slots.size()) {
+                i = 0;
+            }
+        }
+    }
+
+    size_t capacity() const {
+        return slots.size();
+    }
+
+    size_t memory_usage() const {
+        return slots.size() * sizeof(Slot);
+    }
+
+    void write(std::ostream& os) const {
+        write_vector(os, slots);
+    }
+
+    void read(std::istream& is) {
+        read_vector(is, slots);
+    }
+
+private:
+    size_t slot_index(uint64_t key) const {
+        // Map the key to [0, slots.size()) without a division
+        return (static_cast<__uint128_t>(key) * slots.size()) >> 64;
+    }
+
+    std::vector<Slot> slots;
+};
+
+#endif
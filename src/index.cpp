@@ -15,58 +15,164 @@
 #include <iostream>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include "io.hpp"
 #include "timer.hpp"
 #include "logger.hpp"
 #include <sstream>
 
 static Logger& logger = Logger::get();
-static const uint32_t STI_FILE_FORMAT_VERSION = 5;
+static const uint32_t STI_FILE_FORMAT_VERSION = 8;
 
 
 namespace {
 
-uint64_t count_randstrobes(const std::string& seq, const IndexParameters& parameters) {
-    uint64_t n_syncmers = 0;
-    SyncmerIterator syncmer_iterator(seq, parameters.syncmer);
-    Syncmer syncmer;
-    while (!(syncmer = syncmer_iterator.next()).is_end()) {
-        n_syncmers++;
+/*
+ * Compute all randstrobes of one reference
+ */
+std::vector<RefRandstrobe> generate_randstrobes(const std::string& seq, uint32_t ref_index, const IndexParameters& parameters) {
+    std::vector<RefRandstrobe> ref_randstrobes;
+    if (seq.length() < parameters.randstrobe.w_max) {
+        return ref_randstrobes;
     }
-    // The last w_min syncmers do not result in a randstrobe
-    if (n_syncmers < parameters.randstrobe.w_min) {
-        return 0;
-    } else {
-        return n_syncmers - parameters.randstrobe.w_min;
+    // Reserve slightly more than the expected number of syncmers to avoid
+    // reallocations in most cases
+    const size_t expected = seq.length() / (parameters.syncmer.k - parameters.syncmer.s + 1);
+    ref_randstrobes.reserve(expected + expected / 16);
+
+    RandstrobeGenerator randstrobe_iter{seq, parameters.syncmer, parameters.randstrobe};
+    Randstrobe randstrobe;
+    while ((randstrobe = randstrobe_iter.next()) != randstrobe_iter.end()) {
+        ref_randstrobes.push_back(RefRandstrobe{
+            randstrobe.hash,
+            randstrobe.strobe1_pos,
+            ref_index,
+            static_cast<uint8_t>(randstrobe.strobe2_pos - randstrobe.strobe1_pos)
+        });
     }
+    return ref_randstrobes;
 }
 
-std::vector<uint64_t> count_all_randstrobes(const References& references, const IndexParameters& parameters, size_t n_threads) {
+/*
+ * Compute the randstrobes of all references in a single pass. The result
+ * has one vector of randstrobes per reference.
+ */
+std::vector<std::vector<RefRandstrobe>> generate_all_randstrobes(const References& references, const IndexParameters& parameters, size_t n_threads) {
     std::vector<std::thread> workers;
     std::atomic_size_t ref_index{0};
 
-    std::vector<uint64_t> counts;
-    counts.assign(references.size(), 0);
+    std::vector<std::vector<RefRandstrobe>> ref_randstrobes(references.size());
 
     for (size_t i = 0; i < n_threads; ++i) {
         workers.push_back(
             std::thread(
-                [&ref_index](const References& references, const IndexParameters& parameters, std::vector<uint64_t>& counts) {
+                [&]() {
                     while (true) {
                         size_t j = ref_index.fetch_add(1);
                         if (j >= references.size()) {
                             break;
                         }
-                        counts[j] = count_randstrobes(references.sequences[j], parameters);
+                        ref_randstrobes[j] = generate_randstrobes(references.sequences[j], static_cast<uint32_t>(j), parameters);
                     }
-                }, std::ref(references), std::ref(parameters), std::ref(counts))
+                })
         );
     }
     for (auto& worker : workers) {
         worker.join();
     }
 
-    return counts;
+    return ref_randstrobes;
+}
+
+/*
+ * Split the sorted randstrobes vector into at most n_parts consecutive ranges
+ * of similar size such that no run of identical hashes is split. Range i is
+ * [boundaries[i], boundaries[i + 1]).
+ */
+std::vector<size_t> run_aligned_boundaries(const std::vector<RefRandstrobe>& randstrobes, size_t n_parts) {
+    std::vector<size_t> boundaries{0};
+    for (size_t i = 1; i < n_parts; ++i) {
+        size_t boundary = std::max(boundaries.back(), randstrobes.size() * i / n_parts);
+        while (boundary > 0 && boundary < randstrobes.size() && randstrobes[boundary].hash() == randstrobes[boundary - 1].hash()) {
+            ++boundary;
+        }
+        if (boundary > boundaries.back() && boundary < randstrobes.size()) {
+            boundaries.push_back(boundary);
+        }
+    }
+    boundaries.push_back(randstrobes.size());
+    return boundaries;
+}
+
+/* Run fn(begin, end, part) for each range in parallel */
+template <typename F>
+void for_each_range(const std::vector<size_t>& boundaries, F fn) {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i + 1 < boundaries.size(); ++i) {
+        workers.push_back(std::thread(fn, boundaries[i], boundaries[i + 1], i));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Bounds for the filter cutoff (around 30-50 on hg38). There is no reason to
+// have a lower cutoff than this when aligning to a smaller genome or contigs.
+// The upper bound limits the cutoff for normal NAM finding; rescue mode is
+// used for more repetitive seeds.
+const unsigned int min_filter_cutoff = 30;
+const unsigned int max_filter_cutoff = 100;
+
+/* Statistics about the runs of identical hashes within a range */
+struct RunStatistics {
+    uint64_t unique_mers{0};
+    uint64_t occur_once{0};
+    uint64_t mid_ab{0};
+    uint64_t high_ab{0};
+
+    // No. of distinct hashes by number of occurrences. Counts above
+    // max_filter_cutoff all go into the last entry.
+    std::vector<uint64_t> count_histogram = std::vector<uint64_t>(max_filter_cutoff + 2, 0);
+
+    RunStatistics& operator+=(const RunStatistics& other) {
+        unique_mers += other.unique_mers;
+        occur_once += other.occur_once;
+        mid_ab += other.mid_ab;
+        high_ab += other.high_ab;
+        for (size_t i = 0; i < count_histogram.size(); ++i) {
+            count_histogram[i] += other.count_histogram[i];
+        }
+        return *this;
+    }
+};
+
+/*
+ * Return the number of occurrences of the repetitive hash at the given index
+ * when sorting the occurrence counts of all repetitive hashes in descending
+ * order (or the smallest count if the index is too large), clamped to
+ * [min_filter_cutoff, max_filter_cutoff]
+ */
+unsigned int filter_cutoff_from_histogram(const std::vector<uint64_t>& count_histogram, uint64_t index_cutoff) {
+    uint64_t n_repetitive = 0;
+    for (size_t count = 2; count < count_histogram.size(); ++count) {
+        n_repetitive += count_histogram[count];
+    }
+    if (n_repetitive == 0) {
+        return min_filter_cutoff;
+    }
+    uint64_t index = std::min(index_cutoff, n_repetitive - 1);
+    uint64_t seen = 0;
+    unsigned int cutoff = 2;
+    for (size_t count = count_histogram.size() - 1; count >= 2; --count) {
+        seen += count_histogram[count];
+        if (seen > index) {
+            cutoff = count;
+            break;
+        }
+    }
+    return std::clamp(cutoff, min_filter_cutoff, max_filter_cutoff);
 }
 
 }
@@ -83,10 +189,16 @@ void StrobemerIndex::write(const std::string& filename) const {
 
     write_int_to_ostream(ofs, filter_cutoff);
     write_int_to_ostream(ofs, bits);
+    write_int_to_ostream(ofs, static_cast<int32_t>(layout));
     parameters.write(ofs);
 
     write_vector(ofs, randstrobes);
-    write_vector(ofs, randstrobe_start_indices);
+    if (layout == IndexLayout::HashTable) {
+        full_hash_table.write(ofs);
+        main_hash_table.write(ofs);
+    } else {
+        randstrobe_start_indices.write(ofs);
+    }
 }
 
 void StrobemerIndex::read(const std::string& filename) {
@@ -119,19 +231,48 @@ void StrobemerIndex::read(const std::string& filename) {
     ifs.seekg(reserved_chunk_size, std::ios_base::cur);
 
     filter_cutoff = read_int_from_istream(ifs);
+    partial_filter_cutoff = filter_cutoff;
     bits = read_int_from_istream(ifs);
+    int32_t layout_value = read_int_from_istream(ifs);
+    if (layout_value != static_cast<int32_t>(IndexLayout::Buckets) && layout_value != static_cast<int32_t>(IndexLayout::HashTable)) {
+        throw InvalidIndexFile("Index file has an unknown index layout");
+    }
+    layout = static_cast<IndexLayout>(layout_value);
     const IndexParameters sti_parameters = IndexParameters::read(ifs);
     if (parameters != sti_parameters) {
         throw InvalidIndexFile("Index parameters in .sti file and those specified on command line differ");
     }
 
     read_vector(ifs, randstrobes);
-    read_vector(ifs, randstrobe_start_indices);
-    if (randstrobe_start_indices.size() != (1u << bits) + 1) {
-        throw InvalidIndexFile("randstrobe_start_indices vector is of the wrong size");
+    if (layout == IndexLayout::HashTable) {
+        full_hash_table.read(ifs);
+        main_hash_table.read(ifs);
+        randstrobe_start_indices.clear();
+    } else {
+        randstrobe_start_indices.read(ifs);
+        if (randstrobe_start_indices.size() != (1u << bits) + 1) {
+            throw InvalidIndexFile("randstrobe_start_indices vector is of the wrong size");
+        }
     }
 }
 
+IndexLayout index_layout_from_string(const std::string& name) {
+    if (name == "buckets") {
+        return IndexLayout::Buckets;
+    } else if (name == "hashtable") {
+        return IndexLayout::HashTable;
+    }
+    throw BadParameter("Index layout must be 'buckets' or 'hashtable'");
+}
+
+std::ostream& operator<<(std::ostream& os, IndexLayout layout) {
+    switch (layout) {
+        case IndexLayout::Buckets: os << "buckets"; break;
+        case IndexLayout::HashTable: os << "hashtable"; break;
+    }
+    return os;
+}
+
 /* Pick a suitable number of bits for indexing randstrobe start indices */
 int pick_bits(SyncmerParameters parameters, size_t size) {
     size_t estimated_number_of_randstrobes = size / (parameters.k - parameters.s + 1) + 1;
@@ -139,28 +280,124 @@ int pick_bits(SyncmerParameters parameters, size_t size) {
     return std::clamp(static_cast<int>(log2(estimated_number_of_randstrobes)) - 1, 8, 31);
 }
 
+/*
+ * Read references from a FASTA file. Each reference sequence is handed to a
+ * worker thread as soon as it has been parsed so that randstrobes are
+ * generated while the rest of the file is read.
+ */
+std::vector<std::vector<RefRandstrobe>> read_references_and_generate_randstrobes(
+    const std::string& filename, const IndexParameters& parameters, size_t n_threads, References& references
+) {
+    std::vector<std::string> names;
+    std::vector<std::string> sequences;
+    std::vector<std::vector<RefRandstrobe>> ref_randstrobes;
+
+    // Parsed sequences that have not been picked up by a worker yet
+    std::deque<std::pair<size_t, std::string>> queue;
+    bool done_parsing = false;
+    std::mutex mutex;
+    std::condition_variable queue_not_empty;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < n_threads; ++i) {
+        workers.push_back(
+            std::thread(
+                [&]() {
+                    while (true) {
+                        std::pair<size_t, std::string> item;
+                        {
+                            std::unique_lock lock{mutex};
+                            queue_not_empty.wait(lock, [&] { return !queue.empty() || done_parsing; });
+                            if (queue.empty()) {
+                                break;
+                            }
+                            item = std::move(queue.front());
+                            queue.pop_front();
+                        }
+                        auto& [ref_index, sequence] = item;
+                        auto randstrobes = generate_randstrobes(sequence, static_cast<uint32_t>(ref_index), parameters);
+                        std::lock_guard guard{mutex};
+                        sequences[ref_index] = std::move(sequence);
+                        ref_randstrobes[ref_index] = std::move(randstrobes);
+                    }
+                })
+        );
+    }
+    auto join_workers = [&]() {
+        {
+            std::lock_guard guard{mutex};
+            done_parsing = true;
+        }
+        queue_not_empty.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    };
+
+    try {
+        read_fasta(filename, [&](std::string&& name, std::string&& sequence) {
+            names.push_back(std::move(name));
+            {
+                std::lock_guard guard{mutex};
+                sequences.emplace_back();
+                ref_randstrobes.emplace_back();
+                queue.emplace_back(sequences.size() - 1, std::move(sequence));
+            }
+            queue_not_empty.notify_one();
+        });
+    } catch (...) {
+        join_workers();
+        throw;
+    }
+    join_workers();
+
+    check_no_duplicates(names);
+    references = References(std::move(sequences), std::move(names));
+    return ref_randstrobes;
+}
+
 void StrobemerIndex::populate(float f, unsigned n_threads) {
-    Timer count_hash;
-    auto randstrobe_counts = count_all_randstrobes(references, parameters, n_threads);
-    stats.elapsed_counting_hashes = count_hash.duration();
+    Timer randstrobes_timer;
+    logger.debug() << "  Generating randstrobes ...\n";
+    auto ref_randstrobes = generate_all_randstrobes(references, parameters, n_threads);
+    auto elapsed_generating = randstrobes_timer.duration();
+    populate_from(ref_randstrobes, f, n_threads);
+    stats.elapsed_generating_seeds += elapsed_generating;
+}
 
+/*
+ * Build the index from randstrobes that have already been generated (one
+ * vector per reference). The vectors are emptied.
+ */
+void StrobemerIndex::populate_from(std::vector<std::vector<RefRandstrobe>>& ref_randstrobes, float f, unsigned n_threads) {
+    if (ref_randstrobes.size() != references.size()) {
+        throw std::invalid_argument("Number of randstrobe vectors does not match number of references");
+    }
+    Timer randstrobes_timer;
     uint64_t total_randstrobes = 0;
-    for (auto& count : randstrobe_counts) {
-        total_randstrobes += count;
+    size_t largest_chunk = 0;
+    for (auto& chunk : ref_randstrobes) {
+        total_randstrobes += chunk.size();
+        largest_chunk = std::max(largest_chunk, chunk.capacity());
     }
     stats.tot_strobemer_count = total_randstrobes;
 
     logger.debug() << "  Total number of randstrobes: " << total_randstrobes << '\n';
-    uint64_t memory_bytes = references.total_length() + sizeof(RefRandstrobe) * total_randstrobes + sizeof(bucket_index_t) * (1u << bits);
+    // While the per-reference vectors are concatenated, about one of them is
+    // allocated in addition to the randstrobes vector
+    uint64_t memory_bytes = references.total_length() + sizeof(RefRandstrobe) * (total_randstrobes + largest_chunk);
+    if (layout == IndexLayout::HashTable) {
+        // Upper bound: Assumes that all randstrobes are distinct
+        memory_bytes += 2 * sizeof(RandstrobeHashTable::Slot) * (total_randstrobes * 3 / 2);
+    } else {
+        memory_bytes += sizeof(uint32_t) * (1u << bits);
+    }
     logger.debug() << "  Estimated total memory usage: " << memory_bytes / 1E9 << " GB\n";
 
     if (total_randstrobes > std::numeric_limits<bucket_index_t>::max()) {
         throw std::range_error("Too many randstrobes");
     }
-    Timer randstrobes_timer;
-    logger.debug() << "  Generating randstrobes ...\n";
-    randstrobes.assign(total_randstrobes, RefRandstrobe{});
-    assign_all_randstrobes(randstrobe_counts, n_threads);
+    assign_all_randstrobes(ref_randstrobes, total_randstrobes);
     stats.elapsed_generating_seeds = randstrobes_timer.duration();
 
     Timer sorting_timer;
@@ -172,194 +409,166 @@ void StrobemerIndex::populate(float f, unsigned n_threads) {
     Timer hash_index_timer;
     logger.debug() << "  Indexing ...\n";
 
-    uint64_t tot_high_ab = 0;
-    uint64_t tot_mid_ab = 0;
-    std::vector<uint64_t> strobemer_counts;
-
-    stats.tot_occur_once = 0;
-    randstrobe_start_indices.reserve((1u << bits) + 1);
-
-    uint64_t unique_mers = randstrobes.empty() ? 0 : 1;
-    randstrobe_hash_t prev_hash = randstrobes.empty() ? 0 : randstrobes[0].hash();
-    unsigned int count = 1;
-    // first randstrobe index will always be the 0
-    if(!randstrobes.empty()) {
-        randstrobe_start_indices.push_back(0);
-    }
-    for (bucket_index_t position = 1; position < randstrobes.size(); ++position) {
-        const randstrobe_hash_t cur_hash = randstrobes[position].hash();
-        if (cur_hash == prev_hash) {
-            ++count;
-            continue;
-        }
-
-        ++unique_mers;
-
-        if (count == 1) {
-            ++stats.tot_occur_once;
-        } else {
-            if (count > 100) {
-                ++tot_high_ab;
+    // Sweep over the sorted randstrobes in parallel to collect statistics
+    auto boundaries = run_aligned_boundaries(randstrobes, n_threads);
+    std::vector<RunStatistics> range_stats(boundaries.size() - 1);
+    for_each_range(boundaries, [&](size_t begin, size_t end, size_t part) {
+        auto& run_stats = range_stats[part];
+        size_t position = begin;
+        while (position < end) {
+            const randstrobe_hash_t cur_hash = randstrobes[position].hash();
+            size_t run_end = position + 1;
+            while (run_end < end && randstrobes[run_end].hash() == cur_hash) {
+                ++run_end;
+            }
+            const uint64_t count = run_end - position;
+            ++run_stats.unique_mers;
+            if (count == 1) {
+                ++run_stats.occur_once;
+            } else if (count > 100) {
+                ++run_stats.high_ab;
             } else {
-                ++tot_mid_ab;
+                ++run_stats.mid_ab;
             }
-            strobemer_counts.push_back(count);
-        }
-        count = 1;
-        const unsigned int cur_hash_N = cur_hash >> (64 - bits);
-        while (randstrobe_start_indices.size() <= cur_hash_N) {
-            randstrobe_start_indices.push_back(position);
+            run_stats.count_histogram[std::min<uint64_t>(count, max_filter_cutoff + 1)]++;
+            position = run_end;
         }
-        prev_hash = cur_hash;
+    });
+    RunStatistics run_stats;
+    for (auto& other : range_stats) {
+        run_stats += other;
     }
-    // wrap up last entry
-    if (count == 1) {
-        ++stats.tot_occur_once;
+    if (layout == IndexLayout::Buckets) {
+        randstrobe_start_indices.build(bits, randstrobes, n_threads);
     } else {
-        if (count > 100) {
-            tot_high_ab++;
-        } else {
-            tot_mid_ab++;
-        }
-        strobemer_counts.push_back(count);
-    }
-    while (randstrobe_start_indices.size() < ((1u << bits) + 1)) {
-        randstrobe_start_indices.push_back(randstrobes.size());
+        randstrobe_start_indices.clear();
+        build_hash_tables();
     }
-    stats.tot_high_ab = tot_high_ab;
-    stats.tot_mid_ab = tot_mid_ab;
-
-    std::sort(strobemer_counts.begin(), strobemer_counts.end(), std::greater<int>());
+    const uint64_t unique_mers = run_stats.unique_mers;
+    stats.tot_occur_once = run_stats.occur_once;
+    stats.tot_high_ab = run_stats.high_ab;
+    stats.tot_mid_ab = run_stats.mid_ab;
 
     uint64_t index_cutoff = unique_mers * f;
     stats.index_cutoff = index_cutoff;
-    if (!strobemer_counts.empty()){
-        filter_cutoff = index_cutoff < strobemer_counts.size() ?  strobemer_counts[index_cutoff] : strobemer_counts.back();
-        filter_cutoff = std::max(30U, filter_cutoff); // cutoff is around 30-50 on hg38. No reason to have a lower cutoff than this if aligning to a smaller genome or contigs.
-        filter_cutoff = std::min(100U, filter_cutoff); // limit upper cutoff for normal NAM finding - use rescue mode instead
-    } else {
-        filter_cutoff = 30;
-    }
+    filter_cutoff = filter_cutoff_from_histogram(run_stats.count_histogram, index_cutoff);
     stats.filter_cutoff = filter_cutoff;
     partial_filter_cutoff = filter_cutoff;
     stats.elapsed_hash_index = hash_index_timer.duration();
     stats.distinct_strobemers = unique_mers;
 }
 
-void StrobemerIndex::assign_all_randstrobes(const std::vector<uint64_t>& randstrobe_counts, size_t n_threads) {
-    // Compute offsets
-    std::vector<size_t> offsets;
-    size_t offset = 0;
-    for (size_t ref_index = 0; ref_index < references.size(); ++ref_index) {
-        offsets.push_back(offset);
-        offset += randstrobe_counts[ref_index];
-    }
-
-    std::vector<std::thread> workers;
-    std::atomic_size_t ref_index{0};
-    for (size_t i = 0; i < n_threads; ++i) {
-        workers.push_back(
-            std::thread(
-                [&]() {
-                    while (true) {
-                        size_t j = ref_index.fetch_add(1);
-                        if (j >= references.size()) {
-                            break;
-                        }
-                        assign_randstrobes(j, offsets[j]);
-                    }
-                })
-        );
+/*
+ * Fill the full and main hash tables with the first position of each
+ * distinct (full or main) hash in the sorted randstrobes vector
+ */
+void StrobemerIndex::build_hash_tables() {
+    const uint64_t main_hash_mask = parameters.randstrobe.main_hash_mask;
+    size_t n_full = 0;
+    size_t n_main = 0;
+    for (bucket_index_t position = 0; position < randstrobes.size(); ++position) {
+        const randstrobe_hash_t hash = randstrobes[position].hash();
+        if (position == 0 || hash != randstrobes[position - 1].hash()) {
+            n_full++;
+            if (position == 0 || (hash & main_hash_mask) != (randstrobes[position - 1].hash() & main_hash_mask)) {
+                n_main++;
+            }
+        }
     }
-    for (auto& worker : workers) {
-        worker.join();
+    full_hash_table.reset(n_full);
+    main_hash_table.reset(n_main);
+    for (bucket_index_t position = 0; position < randstrobes.size(); ++position) {
+        const randstrobe_hash_t hash = randstrobes[position].hash();
+        if (position == 0 || hash != randstrobes[position - 1].hash()) {
+            full_hash_table.insert(hash, position);
+            if (position == 0 || (hash & main_hash_mask) != (randstrobes[position - 1].hash() & main_hash_mask)) {
+                main_hash_table.insert(hash & main_hash_mask, position);
+            }
+        }
     }
 }
 
 /*
- * Compute randstrobes of one reference and assign them to the randstrobes
- * vector starting from the given offset
+ * Concatenate the per-reference randstrobe vectors into the randstrobes
+ * vector. Each per-reference vector is released as soon as it has been
+ * appended. Since capacity for the randstrobes vector is only reserved (not
+ * filled), its memory is committed as it is written, so peak memory usage
+ * exceeds the size of the final vector by about one per-reference vector
+ * instead of doubling.
  */
-void StrobemerIndex::assign_randstrobes(size_t ref_index, size_t offset) {
-    auto& seq = references.sequences[ref_index];
-    if (seq.length() < parameters.randstrobe.w_max) {
-        return;
-    }
-    RandstrobeGenerator randstrobe_iter{seq, parameters.syncmer, parameters.randstrobe};
-    std::vector<Randstrobe> chunk;
-    // TODO
-    // Chunking makes this function faster, but the speedup is achieved even
-    // with a chunk size of 1.
-    const size_t chunk_size = 4;
-    chunk.reserve(chunk_size);
-    bool end = false;
-    while (!end) {
-        // fill chunk
-        Randstrobe randstrobe;
-        while (chunk.size() < chunk_size) {
-            randstrobe = randstrobe_iter.next();
-            if (randstrobe == randstrobe_iter.end()) {
-                end = true;
-                break;
-            }
-            chunk.push_back(randstrobe);
-        }
-        for (auto randstrobe : chunk) {
-            randstrobes[offset++] = RefRandstrobe{
-                randstrobe.hash,
-                randstrobe.strobe1_pos,
-                static_cast<uint32_t>(ref_index),
-                static_cast<uint8_t>(randstrobe.strobe2_pos - randstrobe.strobe1_pos)
-            };
-        }
-        chunk.clear();
+void StrobemerIndex::assign_all_randstrobes(std::vector<std::vector<RefRandstrobe>>& ref_randstrobes, size_t total_randstrobes) {
+    std::vector<RefRandstrobe>().swap(randstrobes);
+    randstrobes.reserve(total_randstrobes);
+    for (auto& chunk : ref_randstrobes) {
+        randstrobes.insert(randstrobes.end(), chunk.begin(), chunk.end());
+        std::vector<RefRandstrobe>().swap(chunk);
     }
 }
 
-void StrobemerIndex::print_diagnostics(const std::string& logfile_name, int k) const {
+void StrobemerIndex::print_diagnostics(const std::string& logfile_name, int k, size_t n_threads) const {
     // Prins to csv file the statistics on the number of seeds of a particular length and what fraction of them them are unique in the index:
     // format:
     // seed_length, count, percentage_unique
 
-    size_t max_size = 100000;
-    std::vector<int> log_count(max_size, 0);  // stores count and each index represents the length
-    std::vector<int> log_unique(max_size, 0);  // stores count unique and each index represents the length
-    std::vector<int> log_repetitive(max_size, 0);  // stores count unique and each index represents the length
-
+    const size_t max_size = 100000;
+    struct SeedLengthStatistics {
+        std::vector<int> log_count = std::vector<int>(max_size, 0);  // stores count and each index represents the length
+        std::vector<randstrobe_hash_t> log_count_squared = std::vector<randstrobe_hash_t>(max_size, 0);
+        std::vector<randstrobe_hash_t> log_count_1000_limit = std::vector<randstrobe_hash_t>(max_size, 0);  // stores count and each index represents the length
+        randstrobe_hash_t tot_seed_count = 0;
+        randstrobe_hash_t tot_seed_count_sq = 0;
+        randstrobe_hash_t tot_seed_count_1000_limit = 0;
+    };
+
+    // The randstrobes are sorted, so the number of occurrences of a hash is
+    // the length of its run
+    auto boundaries = run_aligned_boundaries(randstrobes, n_threads);
+    std::vector<SeedLengthStatistics> range_stats(boundaries.size() - 1);
+    for_each_range(boundaries, [&](size_t begin, size_t end, size_t part) {
+        auto& seed_stats = range_stats[part];
+        size_t position = begin;
+        while (position < end) {
+            size_t run_end = position + 1;
+            while (run_end < end && randstrobes[run_end].hash() == randstrobes[position].hash()) {
+                ++run_end;
+            }
+            const randstrobe_hash_t count = run_end - position;
+            for (; position < run_end; ++position) {
+                size_t seed_length = strobe2_offset(position) + k;
+                if (seed_length >= max_size) {
+                    // Can happen, e.g., over centromere
+                    continue;
+                }
+                seed_stats.log_count[seed_length]++;
+                seed_stats.log_count_squared[seed_length] += count;
+                seed_stats.tot_seed_count++;
+                seed_stats.tot_seed_count_sq += count;
+                if (count <= 1000) {
+                    seed_stats.log_count_1000_limit[seed_length]++;
+                    seed_stats.tot_seed_count_1000_limit++;
+                }
+            }
+        }
+    });
 
-    std::vector<randstrobe_hash_t> log_count_squared(max_size,0);
+    auto& log_count = range_stats[0].log_count;
+    auto& log_count_squared = range_stats[0].log_count_squared;
+    auto& log_count_1000_limit = range_stats[0].log_count_1000_limit;
     randstrobe_hash_t tot_seed_count = 0;
     randstrobe_hash_t tot_seed_count_sq = 0;
-
-    std::vector<randstrobe_hash_t> log_count_1000_limit(max_size, 0);  // stores count and each index represents the length
     randstrobe_hash_t tot_seed_count_1000_limit = 0;
-
-    size_t seed_length = 0;
-
-    for (size_t it = 0; it < randstrobes.size(); it++) {
-        seed_length = strobe2_offset(it) + k;
-        auto count = get_count_full(find_full(get_hash(it)));
-
-        if (seed_length < max_size){
-            log_count[seed_length] ++;
-            log_count_squared[seed_length] += count;
-            tot_seed_count ++;
-            tot_seed_count_sq += count;
-            if (count <= 1000){
-                log_count_1000_limit[seed_length] ++;
-                tot_seed_count_1000_limit ++;
+    for (size_t part = 0; part < range_stats.size(); ++part) {
+        auto& seed_stats = range_stats[part];
+        if (part > 0) {
+            for (size_t i = 0; i < max_size; ++i) {
+                log_count[i] += seed_stats.log_count[i];
+                log_count_squared[i] += seed_stats.log_count_squared[i];
+                log_count_1000_limit[i] += seed_stats.log_count_1000_limit[i];
             }
-        } else {
-            // TODO This function should not log anything
-            // logger.info() << "Detected seed size over " << max_size << " bp (can happen, e.g., over centromere): " << seed_length << std::endl;
-        }
-
-        if (count == 1 && seed_length < max_size) {
-            log_unique[seed_length]++;
-        }
-        if (count >= 10 && seed_length < max_size) {
-            log_repetitive[seed_length]++;
         }
+        tot_seed_count += seed_stats.tot_seed_count;
+        tot_seed_count_sq += seed_stats.tot_seed_count_sq;
+        tot_seed_count_1000_limit += seed_stats.tot_seed_count_1000_limit;
     }
 
     // printing
@@ -17,6 +17,8 @@
 #include "refs.hpp"
 #include "randstrobes.hpp"
 #include "indexparameters.hpp"
+#include "hashtable.hpp"
+#include "bucketdirectory.hpp"
 
 
 struct IndexCreationStatistics {
@@ -28,23 +30,46 @@ struct IndexCreationStatistics {
     uint64_t filter_cutoff = 0;
     uint64_t distinct_strobemers = 0;
 
-    std::chrono::duration<double> elapsed_hash_index;
-    std::chrono::duration<double> elapsed_generating_seeds;
-    std::chrono::duration<double> elapsed_counting_hashes;
-    std::chrono::duration<double> elapsed_sorting_seeds;
+    std::chrono::duration<double> elapsed_hash_index{0};
+    std::chrono::duration<double> elapsed_generating_seeds{0};
+    std::chrono::duration<double> elapsed_sorting_seeds{0};
 };
 
 int pick_bits(SyncmerParameters parameters, size_t size);
 
+std::vector<std::vector<RefRandstrobe>> read_references_and_generate_randstrobes(
+    const std::string& filename, const IndexParameters& parameters, size_t n_threads, References& references
+);
+
+/*
+ * How the sorted randstrobes vector is searched
+ *
+ * - Buckets: A directory indexed by the top *bits* bits of the hash points to
+ *   the start of each bucket, which is then searched.
+ * - HashTable: Open-addressing hash tables (one for the full hash, one for
+ *   the main hash) point directly to the first occurrence.
+ */
+enum class IndexLayout : int32_t {
+    Buckets = 0,
+    HashTable = 1,
+};
+
+IndexLayout index_layout_from_string(const std::string& name);
+std::ostream& operator<<(std::ostream& os, IndexLayout layout);
+
 struct StrobemerIndex {
     using bucket_index_t = uint64_t;
-    StrobemerIndex(const References& references, const IndexParameters& parameters, int bits=-1)
+    StrobemerIndex(const References& references, const IndexParameters& parameters, int bits=-1, IndexLayout layout=IndexLayout::Buckets)
         : filter_cutoff(0)
         , partial_filter_cutoff(0)
         , parameters(parameters)
         , references(references)
         , bits(bits == -1 ? pick_bits(parameters.syncmer, references.total_length()) : bits)
+        , layout(layout)
     {
+        if (layout != IndexLayout::Buckets) {
+            return;
+        }
         if (this->bits < 8 || this->bits > 31) {
             throw BadParameter("Bits must be between 8 and 31");
         }
@@ -59,10 +84,14 @@ struct StrobemerIndex {
     void write(const std::string& filename) const;
     void read(const std::string& filename);
     void populate(float f, unsigned n_threads);
-    void print_diagnostics(const std::string& logfile_name, int k) const;
+    void populate_from(std::vector<std::vector<RefRandstrobe>>& ref_randstrobes, float f, unsigned n_threads);
+    void print_diagnostics(const std::string& logfile_name, int k, size_t n_threads = 1) const;
 
     // Find first entry that matches the given key
     size_t find_full(randstrobe_hash_t key) const {
+        if (layout == IndexLayout::HashTable) {
+            return full_hash_table.find(key & RANDSTROBE_HASH_MASK);
+        }
         return find(key, RANDSTROBE_HASH_MASK);
     }
 
@@ -71,9 +100,59 @@ struct StrobemerIndex {
      * least significant bits)
      */
     size_t find_partial(randstrobe_hash_t key) const {
+        if (layout == IndexLayout::HashTable) {
+            return main_hash_table.find(key & parameters.randstrobe.main_hash_mask);
+        }
         return find(key, parameters.randstrobe.main_hash_mask);
     }
 
+    /*
+     * Find both the first entry that matches the full hash and the first
+     * entry that matches the main hash (as find_full and find_partial would).
+     *
+     * Only the main hash is looked up in the bucket directory or hash table.
+     * Since the main hash occupies the most significant bits, the entries
+     * with the same main hash form a contiguous run that starts at the
+     * partial match, and a full match can only be found within that run.
+     * The full hash is therefore searched by galloping from the start of the
+     * run. All entries after the run have a greater hash than the key, so
+     * the search does not extend beyond the run by more than the last step.
+     */
+    std::pair<size_t, size_t> find_full_and_partial(randstrobe_hash_t key) const {
+        const size_t partial_position = find_partial(key);
+        if (partial_position == end()) {
+            return {end(), end()};
+        }
+        const randstrobe_hash_t full_key = key & RANDSTROBE_HASH_MASK;
+        if (randstrobes[partial_position].hash() >= full_key) {
+            if (randstrobes[partial_position].hash() == full_key) {
+                return {partial_position, partial_position};
+            }
+            return {end(), partial_position};
+        }
+        // Invariant: randstrobes[lo] has a smaller hash than the key, and
+        // randstrobes[search_end] (if it exists) does not
+        size_t lo = partial_position;
+        size_t step = 1;
+        size_t search_end = lo + step;
+        while (search_end < randstrobes.size() && randstrobes[search_end].hash() < full_key) {
+            lo = search_end;
+            step *= 2;
+            search_end = lo + step;
+        }
+        search_end = std::min(search_end + 1, randstrobes.size());
+        auto pos = std::lower_bound(
+            randstrobes.begin() + lo + 1,
+            randstrobes.begin() + search_end,
+            full_key,
+            [](const RefRandstrobe& lhs, randstrobe_hash_t rhs) { return lhs.hash() < rhs; }
+        );
+        if (pos != randstrobes.begin() + search_end && pos->hash() == full_key) {
+            return {pos - randstrobes.begin(), partial_position};
+        }
+        return {end(), partial_position};
+    }
+
     /*
      * Find first entry whose hash matches the given key. Mask both key and
      * entry by hash_mask.
@@ -133,7 +212,15 @@ struct StrobemerIndex {
         if (is_filtered_forward(position)) {
             return true;
         }
-        bucket_index_t position_revcomp = find_full(hash_revcomp);
+        return is_filtered_with_revcomp(position, find_full(hash_revcomp));
+    }
+
+    /*
+     * Same as is_filtered, but for a position that is known not to be
+     * filtered in forward direction and for which the position of the
+     * reverse-complement hash has already been looked up
+     */
+    bool is_filtered_with_revcomp(bucket_index_t position, bucket_index_t position_revcomp) const {
         if (position_revcomp == end()) {
             return false;
         }
@@ -155,7 +242,10 @@ struct StrobemerIndex {
         if (is_partial_filtered_forward(position)) {
             return true;
         }
-        bucket_index_t position_revcomp = find_partial(hash_revcomp);
+        return is_partial_filtered_with_revcomp(position, find_partial(hash_revcomp));
+    }
+
+    bool is_partial_filtered_with_revcomp(bucket_index_t position, bucket_index_t position_revcomp) const {
         if (position_revcomp == end()) {
             return false;
         }
@@ -217,6 +307,10 @@ struct StrobemerIndex {
         const auto key = randstrobes[position].hash();
         randstrobe_hash_t masked_key = key & hash_mask;
 
+        if (layout == IndexLayout::HashTable) {
+            return get_count_unbounded(position, masked_key, hash_mask);
+        }
+
         const unsigned int top_N = key >> (64 - bits);
         bucket_index_t position_end = randstrobe_start_indices[top_N + 1];
         uint64_t count = 1;
@@ -252,13 +346,48 @@ struct StrobemerIndex {
         return bits;
     }
 
+    IndexLayout get_layout() const {
+        return layout;
+    }
+
     uint64_t get_main_hash_mask() const {
         return parameters.randstrobe.main_hash_mask;
     }
 
 private:
-    void assign_all_randstrobes(const std::vector<uint64_t>& randstrobe_counts, size_t n_threads);
-    void assign_randstrobes(size_t ref_index, size_t offset);
+    void assign_all_randstrobes(std::vector<std::vector<RefRandstrobe>>& ref_randstrobes, size_t total_randstrobes);
+    void build_hash_tables();
+
+    /*
+     * Count the entries starting at position whose masked hash is masked_key
+     * when there is no bucket end to bound the search: Scan linearly at first
+     * and then search in exponentially growing steps.
+     */
+    unsigned int get_count_unbounded(bucket_index_t position, randstrobe_hash_t masked_key, uint64_t hash_mask) const {
+        constexpr unsigned int MAX_LINEAR_SEARCH = 8;
+        const bucket_index_t size = randstrobes.size();
+        bucket_index_t end = position + 1;
+        for ( ; end < size && end - position < MAX_LINEAR_SEARCH; ++end) {
+            if ((randstrobes[end].hash() & hash_mask) != masked_key) {
+                return end - position;
+            }
+        }
+        // Invariant: randstrobes[lo] matches, randstrobes[hi] (if it exists) does not
+        bucket_index_t lo = end - 1;
+        bucket_index_t step = MAX_LINEAR_SEARCH;
+        bucket_index_t hi = lo + step;
+        while (hi < size && (randstrobes[hi].hash() & hash_mask) == masked_key) {
+            lo = hi;
+            step *= 2;
+            hi = lo + step;
+        }
+        hi = std::min(hi, size);
+        auto cmp = [&hash_mask](randstrobe_hash_t masked, const RefRandstrobe& rhs) {
+            return masked < (rhs.hash() & hash_mask);
+        };
+        auto pos = std::upper_bound(randstrobes.begin() + lo + 1, randstrobes.begin() + hi, masked_key, cmp);
+        return (pos - randstrobes.begin()) - position;
+    }
 
     const IndexParameters& parameters;
     const References& references;
@@ -266,18 +395,25 @@ private:
     /*
      * The randstrobes vector contains all randstrobes sorted by hash.
      *
-     * The randstrobe_start_indices vector points to entries in the
+     * The randstrobe_start_indices directory points to entries in the
      * randstrobes vector. randstrobe_start_indices[x] is the index of the
      * first entry in randstrobes whose top *bits* bits of its hash value are
      * greater than or equal to x.
      *
      * randstrobe_start_indices has one extra guard entry at the end that
      * is always randstrobes.size().
+     *
+     * With the HashTable layout, randstrobe_start_indices is empty and
+     * full_hash_table and main_hash_table map a (full or main) hash to the
+     * index of its first entry in the randstrobes vector instead.
      */
 
     std::vector<RefRandstrobe> randstrobes;
-    std::vector<bucket_index_t> randstrobe_start_indices;
+    BucketDirectory randstrobe_start_indices;
+    RandstrobeHashTable full_hash_table;
+    RandstrobeHashTable main_hash_table;
     int bits; // no. of bits of the hash to use when indexing a randstrobe bucket
+    IndexLayout layout;
 };
 
 #endif
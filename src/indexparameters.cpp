@@ -9,7 +9,8 @@
 bool SyncmerParameters::operator==(const SyncmerParameters& other) const {
     return this->s == other.s
         && this->k == other.k
-        && this->t_syncmer == other.t_syncmer;
+        && this->t_syncmer == other.t_syncmer
+        && this->hash == other.hash;
 }
 
 bool RandstrobeParameters::operator==(const RandstrobeParameters& other) const {
@@ -47,7 +48,7 @@ static std::vector<Profile> profiles = {
  * k, s, l, u, c and max_seed_len can be used to override determined parameters
  * by setting them to a value other than IndexParameters::DEFAULT.
  */
-IndexParameters IndexParameters::from_read_length(int read_length, int k, int s, int l, int u, int c, int max_seed_len, int aux_len) {
+IndexParameters IndexParameters::from_read_length(int read_length, int k, int s, int l, int u, int c, int max_seed_len, int aux_len, SyncmerHash hash) {
     const int default_c = 8;
     size_t canonical_read_length = 50;
     for (const auto& p : profiles) {
@@ -81,7 +82,7 @@ IndexParameters IndexParameters::from_read_length(int read_length, int k, int s,
         aux_len = 17;
     }
 
-    return IndexParameters(canonical_read_length, k, s, l, u, q, max_dist, aux_len);
+    return IndexParameters(canonical_read_length, k, s, l, u, q, max_dist, aux_len, hash);
 }
 
 void IndexParameters::write(std::ostream& os) const {
@@ -93,19 +94,25 @@ void IndexParameters::write(std::ostream& os) const {
     write_int_to_ostream(os, randstrobe.q);
     write_int_to_ostream(os, randstrobe.max_dist);
     write_uint64_to_ostream(os, randstrobe.main_hash_mask);
+    write_int_to_ostream(os, static_cast<int32_t>(syncmer.hash));
 }
 
 IndexParameters IndexParameters::read(std::istream& is) {
     size_t canonical_read_length = read_int_from_istream(is);
     int k = read_int_from_istream(is);
     int s = read_int_from_istream(is);
-    const SyncmerParameters syncmer_parameters{k, s};
 
     uint32_t w_min = read_int_from_istream(is);
     uint32_t w_max = read_int_from_istream(is);
     uint64_t q = read_int_from_istream(is);
     int max_dist = read_int_from_istream(is);
     uint64_t main_hash_mask = read_uint64_from_istream(is);
+    int32_t hash_value = read_int_from_istream(is);
+    if (hash_value != static_cast<int32_t>(SyncmerHash::XXH64) && hash_value != static_cast<int32_t>(SyncmerHash::MultiplyXorshift)) {
+        throw InvalidIndexFile("Index file uses an unknown syncmer hash function");
+    }
+    const SyncmerHash hash = static_cast<SyncmerHash>(hash_value);
+    const SyncmerParameters syncmer_parameters{k, s, hash};
     const RandstrobeParameters randstrobe_parameters{q, max_dist, w_min, w_max, main_hash_mask};
 
     return IndexParameters(canonical_read_length, syncmer_parameters, randstrobe_parameters);
@@ -124,19 +131,40 @@ bool IndexParameters::operator==(const IndexParameters& other) const {
  */
 std::string IndexParameters::filename_extension() const {
     std::stringstream sstream;
-    if (*this == from_read_length(canonical_read_length)) {
+    if (*this == from_read_length(canonical_read_length, DEFAULT, DEFAULT, DEFAULT, DEFAULT, DEFAULT, DEFAULT, DEFAULT, syncmer.hash)) {
         // nothing was overridden
         sstream << ".r" << canonical_read_length;
+        if (syncmer.hash != SyncmerHash::XXH64) {
+            sstream << "." << syncmer.hash;
+        }
     }
     sstream << ".sti";
     return sstream.str();
 }
 
+SyncmerHash syncmer_hash_from_string(const std::string& name) {
+    if (name == "xxh64") {
+        return SyncmerHash::XXH64;
+    } else if (name == "mx") {
+        return SyncmerHash::MultiplyXorshift;
+    }
+    throw BadParameter("Syncmer hash function must be 'xxh64' or 'mx'");
+}
+
+std::ostream& operator<<(std::ostream& os, SyncmerHash hash) {
+    switch (hash) {
+        case SyncmerHash::XXH64: os << "xxh64"; break;
+        case SyncmerHash::MultiplyXorshift: os << "mx"; break;
+    }
+    return os;
+}
+
 std::ostream& operator<<(std::ostream& os, const SyncmerParameters& parameters) {
     os << "SyncmerParameters("
         << "k=" << parameters.k
         << ", s=" << parameters.s
         << ", t_syncmer=" << parameters.t_syncmer
+        << ", hash=" << parameters.hash
         << ")";
     return os;
 }
@@ -158,6 +186,7 @@ std::ostream& operator<<(std::ostream& os, const IndexParameters& parameters) {
         << ", k=" << parameters.syncmer.k
         << ", s=" << parameters.syncmer.s
         << ", t_syncmer=" << parameters.syncmer.t_syncmer
+        << ", hash=" << parameters.syncmer.hash
         << ", q=" << parameters.randstrobe.q
         << ", max_dist=" << parameters.randstrobe.max_dist
         << ", w_min=" << parameters.randstrobe.w_min
@@ -5,18 +5,34 @@
 #include <algorithm>
 #include <iostream>
 #include <limits>
+#include <string>
 #include "exceptions.hpp"
 
+/*
+ * The function used for hashing syncmers (both the s-mers that decide
+ * whether a k-mer is a syncmer and the k-mers themselves). MultiplyXorshift
+ * is cheaper to compute than XXH64, but indices built with different hash
+ * functions are incompatible.
+ */
+enum class SyncmerHash : int32_t {
+    XXH64 = 0,
+    MultiplyXorshift = 1,
+};
+
+SyncmerHash syncmer_hash_from_string(const std::string& name);
+std::ostream& operator<<(std::ostream& os, SyncmerHash hash);
 
 struct SyncmerParameters {
     const int k;
     const int s;
     const int t_syncmer;
+    const SyncmerHash hash;
 
-    SyncmerParameters(int k, int s)
+    SyncmerParameters(int k, int s, SyncmerHash hash = SyncmerHash::XXH64)
         : k(k)
         , s(s)
         , t_syncmer((k - s) / 2 + 1)
+        , hash(hash)
     {
         verify();
     }
@@ -77,9 +93,9 @@ public:
 
     static const int DEFAULT = std::numeric_limits<int>::min();
 
-    IndexParameters(size_t canonical_read_length, int k, int s, int l, int u, uint64_t q, int max_dist, int aux_len)
+    IndexParameters(size_t canonical_read_length, int k, int s, int l, int u, uint64_t q, int max_dist, int aux_len, SyncmerHash hash = SyncmerHash::XXH64)
         : canonical_read_length(canonical_read_length)
-        , syncmer(k, s)
+        , syncmer(k, s, hash)
         , randstrobe(q, max_dist, std::max(0, k / (k - s + 1) + l), k / (k - s + 1) + u, ~0ul << (9 + aux_len))
     {
         verify(aux_len);
@@ -99,7 +115,7 @@ public:
     }
 
     static IndexParameters from_read_length(
-        int read_length, int k = DEFAULT, int s = DEFAULT, int l = DEFAULT, int u = DEFAULT, int c = DEFAULT, int max_seed_len = DEFAULT, int aux_len = DEFAULT);
+        int read_length, int k = DEFAULT, int s = DEFAULT, int l = DEFAULT, int u = DEFAULT, int c = DEFAULT, int max_seed_len = DEFAULT, int aux_len = DEFAULT, SyncmerHash hash = SyncmerHash::XXH64);
     static IndexParameters read(std::istream& os);
     std::string filename_extension() const;
     void write(std::ostream& os) const;
@@ -7,17 +7,110 @@
 #include <system_error>
 #include "exceptions.hpp"
 
-void GzipReader::open(const std::string& filename) {
-    if (filename != "") {
-        file = gzopen(filename.c_str(), "r");
-        if (file == nullptr) {
-            throw InvalidFile("Could not open file: " + filename);
+void StreamReader::open(const std::string& filename) {
+    fd = ::open(filename.c_str(), 0);
+    if (fd < 0) {
+        throw InvalidFile("Could not open file: " + filename);
+    }
+    input.resize(128 * 1024);
+}
+
+void StreamReader::close() {
+    if (compressed) {
+        inflateEnd(&zs);
+    }
+    if (fd != -1) {
+        ::close(fd);
+    }
+    fd = -1;
+}
+
+/* Read what is available into the input buffer after position input_end */
+int64_t StreamReader::fill_input() {
+    ssize_t n;
+    do {
+        n = ::read(fd, input.data() + input_end, input.size() - input_end);
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+        input_end += n;
+    }
+    return n;
+}
+
+/* Return false if the input could not be read */
+bool StreamReader::detect_compression() {
+    // The gzip magic number has two bytes
+    while (input_end < 2) {
+        auto n = fill_input();
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            break;
         }
     }
+    compressed = input_end >= 2 && input[0] == 0x1f && input[1] == 0x8b;
+    if (compressed && inflateInit2(&zs, 15 + 16) != Z_OK) {
+        return false;
+    }
+    detected = true;
+    return true;
 }
 
-int64_t GzipReader::read(void* buffer, size_t length) {
-    return gzread(file, buffer, length);
+int64_t StreamReader::read(void* buffer, size_t length) {
+    if (!detected && !detect_compression()) {
+        return -1;
+    }
+    if (!compressed) {
+        if (input_start < input_end) {
+            size_t n = std::min(length, input_end - input_start);
+            memcpy(buffer, input.data() + input_start, n);
+            input_start += n;
+            return n;
+        }
+        ssize_t n;
+        do {
+            n = ::read(fd, buffer, length);
+        } while (n < 0 && errno == EINTR);
+        return n;
+    }
+
+    zs.next_out = static_cast<Bytef*>(buffer);
+    zs.avail_out = length;
+    // Return as soon as anything has been decompressed
+    while (zs.avail_out == length) {
+        if (input_start == input_end) {
+            input_start = input_end = 0;
+            auto n = fill_input();
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                // Like gzread, treat truncated input as ending early
+                return 0;
+            }
+        }
+        if (member_end) {
+            // Like gzread, ignore anything after the last member that is not
+            // the start of another member
+            if (input[input_start] != 0x1f) {
+                input_start = input_end;
+                return 0;
+            }
+            inflateReset(&zs);
+            member_end = false;
+        }
+        zs.next_in = input.data() + input_start;
+        zs.avail_in = input_end - input_start;
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        input_start = input_end - zs.avail_in;
+        if (ret == Z_STREAM_END) {
+            member_end = true;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return -1;
+        }
+    }
+    return length - zs.avail_out;
 }
 
 void UncompressedReader::open(const std::string& filename) {
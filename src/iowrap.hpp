@@ -22,21 +22,51 @@ class Reader {
     virtual void open(const std::string& filename) = 0;
 };
 
-class GzipReader : public Reader {
+/*
+ * Reader for stdin, pipes and other input that cannot be memory-mapped.
+ *
+ * read() returns as soon as some data is available instead of waiting until
+ * the buffer is full, so that records are passed on as they arrive.
+ * gzip-compressed input (possibly with multiple members) is detected and
+ * decompressed; other input is passed through unchanged.
+ */
+class StreamReader : public Reader {
    public:
-    GzipReader(const std::string& filename) : Reader(filename), file() { open(filename); }
+    StreamReader(const std::string& filename)
+        : Reader(filename)
+        , fd(-1)
+        , compressed(false)
+        , detected(false)
+        , member_end(false)
+        , zs()
+        , input()
+        , input_start(0)
+        , input_end(0) {
+        open(filename);
+    }
 
-    virtual ~GzipReader() {
-        if (file) {
-            gzclose(file);
+    virtual ~StreamReader() {
+        if (fd != -1) {
+            close();
         }
     }
 
     int64_t read(void* buffer, size_t length) override;
 
    private:
-    gzFile file;
+    int fd;
+    bool compressed;
+    bool detected;  // whether the first bytes have been inspected
+    bool member_end;  // whether the end of a gzip member has been reached
+    z_stream zs;
+    std::vector<uint8_t> input;
+    size_t input_start;
+    size_t input_end;
+
     void open(const std::string& filename) override;
+    void close();
+    int64_t fill_input();
+    bool detect_compression();
 };
 
 class UncompressedReader : public Reader {
@@ -9,6 +9,10 @@
 #include <cassert>
 #include <iomanip>
 #include <chrono>
+#include <future>
+#include <optional>
+#include <filesystem>
+#include <cstdio>
 #ifdef _WIN32
 #include <io.h>
 #else
@@ -20,12 +24,14 @@
 #include "cmdline.hpp"
 #include "index.hpp"
 #include "pc.hpp"
+#include "checkpoint.hpp"
 #include "aln.hpp"
 #include "logger.hpp"
 #include "timer.hpp"
 #include "readlen.hpp"
 #include "version.hpp"
 #include "randstrobes.hpp"
+#include "simd.hpp"
 #include "buildconfig.hpp"
 
 
@@ -138,7 +144,11 @@ int run_strobealign(int argc, char **argv) {
     logger.info() << "This is strobealign " << version_string() << '\n';
     logger.debug() << "Build type: " << CMAKE_BUILD_TYPE << '\n';
     warn_if_no_optimizations();
-    logger.debug() << "AVX2 enabled: " << (avx2_enabled() ? "yes" : "no") << '\n';
+    logger.debug() << "AVX2 enabled at compile time: " << (avx2_enabled() ? "yes" : "no") << '\n';
+    if (!opt.simd.empty()) {
+        set_simd_level(simd_level_from_string(opt.simd));
+    }
+    logger.debug() << "SIMD instruction set: " << to_string(simd_level()) << " (supported: " << to_string(detected_simd_level()) << ")\n";
 
     if (opt.c >= 64 || opt.c <= 0) {
         throw BadParameter("c must be greater than 0 and less than 64");
@@ -154,6 +164,12 @@ int run_strobealign(int argc, char **argv) {
         logger.info() << "Estimated read length: " << opt.r << " bp\n";
         input_buffer.rewind_reset();
     }
+    if (opt.max_batch_delay > 0) {
+        if (!opt.r_set) {
+            logger.info() << "Estimating the read length waits for the first 500 reads. Use -r to avoid this delay in low-latency mode\n";
+        }
+        input_buffer.set_max_batch_delay(std::chrono::milliseconds(opt.max_batch_delay));
+    }
     IndexParameters index_parameters = IndexParameters::from_read_length(
         opt.r,
         opt.k_set ? opt.k : IndexParameters::DEFAULT,
@@ -162,7 +178,8 @@ int run_strobealign(int argc, char **argv) {
         opt.u_set ? opt.u : IndexParameters::DEFAULT,
         opt.c_set ? opt.c : IndexParameters::DEFAULT,
         opt.max_seed_len_set ? opt.max_seed_len : IndexParameters::DEFAULT,
-        opt.aux_len ? opt.aux_len : IndexParameters::DEFAULT
+        opt.aux_len ? opt.aux_len : IndexParameters::DEFAULT,
+        syncmer_hash_from_string(opt.hash)
     );
     AlignmentParameters aln_params;
     aln_params.match = opt.A;
@@ -178,6 +195,9 @@ int run_strobealign(int argc, char **argv) {
     map_param.rescue_level = opt.rescue_level;
     map_param.max_tries = opt.max_tries;
     map_param.use_mcs = opt.mcs;
+    map_param.exact_fast_path = opt.exact_fast_path;
+    map_param.long_reads = opt.long_reads;
+    map_param.min_seed_quality = opt.min_seed_quality;
     map_param.output_format = (
             opt.is_abundance_out ? OutputFormat::Abundance :
             opt.is_sam_out ? OutputFormat::SAM :
@@ -201,9 +221,37 @@ int run_strobealign(int argc, char **argv) {
 
     // Create index
     References references;
+    std::vector<std::vector<RefRandstrobe>> ref_randstrobes;
+    std::optional<StrobemerIndex> index_holder;
+    if (!opt.only_gen_index) {
+        // Read and decompress the first chunks of reads while the index is
+        // loaded or built
+        input_buffer.start_reading();
+    }
+    std::future<double> index_loaded;
+    if (opt.use_index) {
+        // Read the index from a file while the reference is read. The index
+        // file determines the number of bits, so the references need not be
+        // known yet.
+        assert(!opt.only_gen_index);
+        index_holder.emplace(references, index_parameters, opt.bits, index_layout_from_string(opt.index_layout));
+        std::string sti_path = opt.ref_filename + index_parameters.filename_extension();
+        logger.info() << "Reading index from " << sti_path << '\n';
+        index_loaded = std::async(std::launch::async, [&index_holder, sti_path]() {
+            Timer read_index_timer;
+            index_holder->read(sti_path);
+            return read_index_timer.elapsed();
+        });
+    }
     Timer read_refs_timer;
-    references = References::from_fasta(opt.ref_filename);
-    logger.info() << "Time reading reference: " << read_refs_timer.elapsed() << " s\n";
+    if (opt.use_index) {
+        references = References::from_fasta(opt.ref_filename);
+        logger.info() << "Time reading reference: " << read_refs_timer.elapsed() << " s\n";
+    } else {
+        // Generate randstrobes while the reference is being parsed
+        ref_randstrobes = read_references_and_generate_randstrobes(opt.ref_filename, index_parameters, opt.n_threads, references);
+        logger.info() << "Time reading reference and generating seeds: " << read_refs_timer.elapsed() << " s\n";
+    }
 
     logger.info() << "Reference size: " << references.total_length() / 1E6 << " Mbp ("
         << references.size() << " contig" << (references.size() == 1 ? "" : "s")
@@ -219,24 +267,23 @@ int run_strobealign(int argc, char **argv) {
 
     logger.debug() << "Auxiliary hash length: " << opt.aux_len << "\n";
     logger.info() << "Using multi-context seeds: " << (map_param.use_mcs ? "yes" : "no") << '\n';
-    StrobemerIndex index(references, index_parameters, opt.bits);
+    if (!opt.use_index) {
+        index_holder.emplace(references, index_parameters, opt.bits, index_layout_from_string(opt.index_layout));
+    }
+    StrobemerIndex& index = *index_holder;
     if (opt.use_index) {
-        // Read the index from a file
-        assert(!opt.only_gen_index);
-        Timer read_index_timer;
-        std::string sti_path = opt.ref_filename + index_parameters.filename_extension();
-        logger.info() << "Reading index from " << sti_path << '\n';
-        index.read(sti_path);
+        auto elapsed = index_loaded.get();
+        logger.debug() << "Index layout: " << index.get_layout() << "\n";
         logger.debug() << "Bits used to index buckets: " << index.get_bits() << "\n";
-        logger.info() << "Total time reading index: " << read_index_timer.elapsed() << " s\n";
+        logger.info() << "Total time reading index: " << elapsed << " s\n";
     } else {
+        logger.debug() << "Index layout: " << index.get_layout() << "\n";
         logger.debug() << "Bits used to index buckets: " << index.get_bits() << "\n";
         logger.info() << "Indexing ...\n";
         Timer index_timer;
-        index.populate(opt.f, opt.n_threads);
-        
-        logger.info() << "  Time counting seeds: " << index.stats.elapsed_counting_hashes.count() << " s" <<  std::endl;
-        logger.info() << "  Time generating seeds: " << index.stats.elapsed_generating_seeds.count() << " s" <<  std::endl;
+        index.populate_from(ref_randstrobes, opt.f, opt.n_threads);
+
+        logger.info() << "  Time collecting seeds: " << index.stats.elapsed_generating_seeds.count() << " s" <<  std::endl;
         logger.info() << "  Time sorting seeds: " << index.stats.elapsed_sorting_seeds.count() << " s" <<  std::endl;
         logger.info() << "  Time generating hash table index: " << index.stats.elapsed_hash_index.count() << " s" <<  std::endl;
         logger.info() << "Total time indexing: " << index_timer.elapsed() << " s\n";
@@ -262,7 +309,7 @@ int run_strobealign(int argc, char **argv) {
         logger.debug() << "Filtered cutoff count: " << index.stats.filter_cutoff << std::endl;
         
         if (!opt.logfile_name.empty()) {
-            index.print_diagnostics(opt.logfile_name, index_parameters.syncmer.k);
+            index.print_diagnostics(opt.logfile_name, index_parameters.syncmer.k, opt.n_threads);
             logger.debug() << "Finished printing log stats" << std::endl;
         }
         if (opt.only_gen_index) {
@@ -281,11 +328,32 @@ int run_strobealign(int argc, char **argv) {
     map_param.rescue_cutoff = map_param.rescue_level < 100 ? map_param.rescue_level * index.filter_cutoff : 1000;
     logger.debug() << "Using rescue cutoff: " << map_param.rescue_cutoff << std::endl;
 
+    std::stringstream cmd_line;
+    for(int i = 0; i < argc; ++i) {
+        cmd_line << argv[i] << " ";
+    }
+    std::optional<Checkpoint> checkpoint;
+    if (!opt.checkpoint_file_name.empty()) {
+        checkpoint = Checkpoint::read(opt.checkpoint_file_name);
+        if (checkpoint && checkpoint->arguments != cmd_line.str()) {
+            throw InvalidFile("Checkpoint " + opt.checkpoint_file_name + " was written by a run with different arguments");
+        }
+    }
+
     std::streambuf* buf;
     std::ofstream of;
 
     if (!opt.write_to_stdout) {
-        of.open(opt.output_file_name);
+        if (checkpoint) {
+            // Discard any output written after the checkpoint
+            if (std::filesystem::file_size(opt.output_file_name) < checkpoint->output_size) {
+                throw InvalidFile("Output file " + opt.output_file_name + " is shorter than recorded in the checkpoint");
+            }
+            std::filesystem::resize_file(opt.output_file_name, checkpoint->output_size);
+            of.open(opt.output_file_name, std::ios::app);
+        } else {
+            of.open(opt.output_file_name);
+        }
         buf = of.rdbuf();
     }
     else {
@@ -293,17 +361,20 @@ int run_strobealign(int argc, char **argv) {
     }
 
     std::ostream out(buf);
-    
+
+    std::string header;
     if (map_param.output_format == OutputFormat::SAM) {
-            std::stringstream cmd_line;
-            for(int i = 0; i < argc; ++i) {
-                cmd_line << argv[i] << " ";
-            }
-            out << sam_header(references, opt.read_group_id, opt.read_group_fields);
+            header = sam_header(references, opt.read_group_id, opt.read_group_fields);
             if (opt.pg_header) {
-                out << pg_header(cmd_line.str());
+                header += pg_header(cmd_line.str());
             }
     }
+    // The outputs of all shards are meant to be concatenated
+    if (!checkpoint && opt.shard_index == 0) {
+        out << header;
+    } else {
+        header.clear();
+    }
 
     std::vector<AlignmentStatistics> worker_statistics(opt.n_threads);
     
@@ -317,6 +388,33 @@ int run_strobealign(int argc, char **argv) {
     logger.info() << "using " << opt.n_threads << " thread" << (opt.n_threads != 1 ? "s" : "") << std::endl;
 
     OutputBuffer output_buffer(out);
+    if (opt.max_batch_delay > 0) {
+        logger.info() << "Low-latency mode: Mapping reads after at most " << opt.max_batch_delay << " ms\n";
+        output_buffer.enable_low_latency();
+    }
+    if (opt.n_shards > 1) {
+        logger.info() << "Processing shard " << opt.shard_index + 1 << " of " << opt.n_shards << '\n';
+        input_buffer.set_shard(opt.shard_index, opt.n_shards);
+        output_buffer.set_shard(opt.shard_index, opt.n_shards);
+    }
+    AlignmentStatistics statistics;
+    std::vector<double> abundances(references.size(), 0);
+    if (!opt.checkpoint_file_name.empty()) {
+        if (checkpoint) {
+            size_t n_skipped = input_buffer.skip_chunks(checkpoint->n_chunks);
+            logger.info() << "Resuming from checkpoint " << opt.checkpoint_file_name << ": Skipped " << n_skipped << " reads\n";
+            statistics = checkpoint->statistics;
+            for (size_t i = 0; i < std::min(abundances.size(), checkpoint->abundances.size()); ++i) {
+                abundances[i] = checkpoint->abundances[i];
+            }
+        } else {
+            checkpoint = Checkpoint{};
+            checkpoint->arguments = cmd_line.str();
+            checkpoint->n_chunks = opt.shard_index;
+            checkpoint->output_size = header.size();
+        }
+        output_buffer.enable_checkpoints(opt.checkpoint_file_name, std::chrono::seconds(opt.checkpoint_interval), *checkpoint);
+    }
     std::vector<std::thread> workers;
     std::vector<int> worker_done(opt.n_threads);  // each thread sets its entry to 1 when it’s done
     std::vector<std::vector<double>> worker_abundances(opt.n_threads, std::vector<double>(references.size(), 0));
@@ -333,15 +431,16 @@ int run_strobealign(int argc, char **argv) {
     for (auto& worker : workers) {
         worker.join();
     }
+    // Record what has been written even if reading the input failed
+    output_buffer.write_checkpoint();
+    input_buffer.rethrow_if_error();
     logger.info() << "Done!\n";
 
-    AlignmentStatistics statistics;
     for (auto& it : worker_statistics) {
         statistics += it;
     }
 
     if (map_param.output_format == OutputFormat::Abundance) {
-        std::vector<double> abundances(references.size(), 0);
         for (size_t i = 0; i < worker_abundances.size(); ++i) {
             for (size_t j = 0; j < worker_abundances[i].size(); ++j) {
                 abundances[j] += worker_abundances[i][j];
@@ -349,6 +448,10 @@ int run_strobealign(int argc, char **argv) {
         }
         output_abundance(out, abundances, references);
     }
+    if (!opt.checkpoint_file_name.empty()) {
+        out.flush();
+        std::remove(opt.checkpoint_file_name.c_str());
+    }
 
     logger.debug()
         << "Number of reads:               " << std::setw(12) << statistics.n_reads << std::endl
@@ -364,7 +467,19 @@ int run_strobealign(int argc, char **argv) {
         << "  Per rescue attempt: " << std::setw(7) << static_cast<float>(statistics.n_rescue_hits) / statistics.nam_rescue << std::endl
         << "Number of rescue NAMs:         " << std::setw(12) << statistics.n_rescue_nams
         << "  Per rescue attempt: " << std::setw(7) << static_cast<float>(statistics.n_rescue_nams) / statistics.nam_rescue << std::endl;
+    if (map_param.long_reads) {
+        logger.info() << "Reads aligned in segments: " << statistics.n_long_reads << std::endl;
+    }
+    if (map_param.min_seed_quality > 0) {
+        logger.info() << "Randstrobes skipped because of low base quality: " << statistics.n_low_quality_randstrobes << std::endl;
+    }
+    if (map_param.exact_fast_path) {
+        logger.info()
+            << "Reads output by exact-match fast path: " << statistics.n_exact_matches << std::endl
+            << "Total time checking for exact matches: " << statistics.tot_exact_match.count() / opt.n_threads << " s." << std::endl;
+    }
     logger.info()
+        << "NAMs merged at the same locus: " << statistics.n_merged_nams << std::endl
         << "Total mapping sites tried: " << statistics.tried_alignment << std::endl
         << "Total calls to ssw: " << statistics.tot_aligner_calls << std::endl
         << "Inconsistent NAM ends: " << statistics.inconsistent_nams << std::endl
@@ -376,6 +491,15 @@ int run_strobealign(int argc, char **argv) {
         << "Total time finding NAMs (rescue mode): " << statistics.tot_time_rescue.count() / opt.n_threads << " s." << std::endl
         << "Total time sorting NAMs (candidate sites): " << statistics.tot_sort_nams.count() / opt.n_threads << " s." << std::endl
         << "Total time extending and pairing seeds: " << statistics.tot_extend.count() / opt.n_threads << " s." << std::endl;
+    if (output_buffer.low_latency && output_buffer.latencies.size() > 0) {
+        const auto& latencies = output_buffer.latencies;
+        logger.info()
+            << "Latency from reading a read to writing its output:"
+            << " p50 " << latencies.percentile(0.5).count() * 1000 << " ms,"
+            << " p90 " << latencies.percentile(0.9).count() * 1000 << " ms,"
+            << " p99 " << latencies.percentile(0.99).count() * 1000 << " ms,"
+            << " max " << latencies.max().count() * 1000 << " ms" << std::endl;
+    }
     return EXIT_SUCCESS;
 }
 
@@ -29,23 +29,12 @@ inline void add_to_matches_map_full(
 }
 
 /*
-This function often produces the same Match multiple times.
-This happens when multiple randstrobes involve a syncmer that has a low hash
-value (and which therefore gets chosen as main hash multiple times).
-
-For example, assume we have syncmers starting at positions 14, 21, 39, 51
-and randstrobes like this:
-
-14, 21, 39, 51
-14------39
-    21--39
-        39--51
-
-If 39 now has the lowest hash value, it will be chosen as the main hash for all
-three randstrobes. Thus, when looking up that main hash, all three randstrobes
-are found. After the start coordinate of the randstrobe is converted to the
-start coordinate of the single syncmer (using strobe_extent_partial()), they all
-result in a hit that starts at 39 (and has length k).
+Add a match for each occurrence of the main syncmer of a partial hit.
+
+The main hash of a reference randstrobe is always the hash of its first
+strobe, and each syncmer is the first strobe of exactly one randstrobe. The
+entries with the same main hash therefore refer to distinct syncmer
+occurrences, and this function does not produce the same Match twice.
 */
 inline void add_to_matches_map_partial(
     robin_hood::unordered_map<unsigned int, std::vector<Match>>& matches_map,
@@ -65,6 +54,17 @@ inline void add_to_matches_map_partial(
     }
 }
 
+/*
+ * A NAM that can still be extended while merging matches. The positions of
+ * the last added match are only needed during merging and are therefore not
+ * part of Nam.
+ */
+struct OpenNam {
+    Nam nam;
+    int query_prev_match_startpos;
+    int ref_prev_match_startpos;
+};
+
 } // namespace
 
 void merge_matches_into_nams(
@@ -85,7 +85,7 @@ void merge_matches_into_nams(
             );
         }
 
-        std::vector<Nam> open_nams;
+        std::vector<OpenNam> open_nams;
         int prev_q_start = 0;
         auto prev_match = Match{0,0,0,0};
         for (auto &m : matches) {
@@ -96,26 +96,24 @@ void merge_matches_into_nams(
             for (auto & o : open_nams) {
 
                 // Extend NAM
-                if ((o.query_prev_match_startpos <= m.query_start) && (m.query_start <= o.query_end ) && (o.ref_prev_match_startpos <= m.ref_start) && (m.ref_start <= o.ref_end) ){
-                    if ( (m.query_end > o.query_end) && (m.ref_end > o.ref_end) ) {
-                        o.query_end = m.query_end;
-                        o.ref_end = m.ref_end;
+                if ((o.query_prev_match_startpos <= m.query_start) && (m.query_start <= o.nam.query_end ) && (o.ref_prev_match_startpos <= m.ref_start) && (m.ref_start <= o.nam.ref_end) ){
+                    if ( (m.query_end > o.nam.query_end) && (m.ref_end > o.nam.ref_end) ) {
+                        o.nam.query_end = m.query_end;
+                        o.nam.ref_end = m.ref_end;
 //                        o.previous_query_start = h.query_s;
 //                        o.previous_ref_start = h.ref_s; // keeping track so that we don't . Can be caused by interleaved repeats.
                         o.query_prev_match_startpos = m.query_start;
                         o.ref_prev_match_startpos = m.ref_start;
-                        o.n_matches ++;
-//                        o.score += (float)1/ (float)h.count;
+                        o.nam.n_matches++;
                         is_added = true;
                         break;
                     }
-                    else if ((m.query_end <= o.query_end) && (m.ref_end <= o.ref_end)) {
+                    else if ((m.query_end <= o.nam.query_end) && (m.ref_end <= o.nam.ref_end)) {
 //                        o.previous_query_start = h.query_s;
 //                        o.previous_ref_start = h.ref_s; // keeping track so that we don't . Can be caused by interleaved repeats.
                         o.query_prev_match_startpos = m.query_start;
                         o.ref_prev_match_startpos = m.ref_start;
-                        o.n_matches ++;
-//                        o.score += (float)1/ (float)h.count;
+                        o.nam.n_matches++;
                         is_added = true;
                         break;
                     }
@@ -124,42 +122,32 @@ void merge_matches_into_nams(
             }
             // Add to open matches
             if (!is_added){
-                Nam n;
-                n.query_start = m.query_start;
-                n.query_end = m.query_end;
-                n.ref_start = m.ref_start;
-                n.ref_end = m.ref_end;
-                n.ref_id = ref_id;
-//                n.previous_query_start = h.query_s;
-//                n.previous_ref_start = h.ref_s;
-                n.query_prev_match_startpos = m.query_start;
-                n.ref_prev_match_startpos = m.ref_start;
-                n.n_matches = 1;
-                n.is_revcomp = is_revcomp;
-//                n.score += (float)1 / (float)h.count;
-                open_nams.push_back(n);
+                OpenNam o;
+                o.nam.query_start = m.query_start;
+                o.nam.query_end = m.query_end;
+                o.nam.ref_start = m.ref_start;
+                o.nam.ref_end = m.ref_end;
+                o.nam.ref_id = ref_id;
+                o.nam.n_matches = 1;
+                o.nam.is_revcomp = is_revcomp;
+                o.query_prev_match_startpos = m.query_start;
+                o.ref_prev_match_startpos = m.ref_start;
+                open_nams.push_back(o);
             }
 
             // Only filter if we have advanced at least k nucleotides
             if (m.query_start > prev_q_start + k) {
 
                 // Output all NAMs from open_matches to final_nams that the current match have passed
-                for (auto &n : open_nams) {
-                    if (n.query_end < m.query_start) {
-                        int n_max_span = std::max(n.query_span(), n.ref_span());
-                        int n_min_span = std::min(n.query_span(), n.ref_span());
-                        float n_score;
-                        n_score = ( 2*n_min_span -  n_max_span) > 0 ? (float) (n.n_matches * ( 2*n_min_span -  n_max_span) ) : 1;   // this is really just n_matches * ( min_span - (offset_in_span) ) );
-//                        n_score = n.n_hits * n.query_span();
-                        n.score = n_score;
-                        n.nam_id = nams.size();
-                        nams.push_back(n);
+                for (auto &o : open_nams) {
+                    if (o.nam.query_end < m.query_start) {
+                        nams.push_back(o.nam);
                     }
                 }
 
                 // Remove all NAMs from open_matches that the current match have passed
                 auto c = m.query_start;
-                auto predicate = [c](decltype(open_nams)::value_type const &nam) { return nam.query_end < c; };
+                auto predicate = [c](const OpenNam& o) { return o.nam.query_end < c; };
                 open_nams.erase(std::remove_if(open_nams.begin(), open_nams.end(), predicate), open_nams.end());
                 prev_q_start = m.query_start;
             }
@@ -167,15 +155,8 @@ void merge_matches_into_nams(
         }
 
         // Add all current open_matches to final NAMs
-        for (auto &n : open_nams) {
-            int n_max_span = std::max(n.query_span(), n.ref_span());
-            int n_min_span = std::min(n.query_span(), n.ref_span());
-            float n_score;
-            n_score = ( 2*n_min_span -  n_max_span) > 0 ? (float) (n.n_matches * ( 2*n_min_span -  n_max_span) ) : 1;   // this is really just n_matches * ( min_span - (offset_in_span) ) );
-//            n_score = n.n_matches * n.query_span();
-            n.score = n_score;
-            n.nam_id = nams.size();
-            nams.push_back(n);
+        for (auto &o : open_nams) {
+            nams.push_back(o.nam);
         }
     }
 }
@@ -198,6 +179,60 @@ robin_hood::unordered_map<unsigned int, std::vector<Match>> hits_to_matches(
     return matches_map;
 }
 
+/*
+ * Look up all query randstrobes in the index. Full matches are preferred;
+ * partial matches are only used in MCS mode (and then found in the same
+ * search as the full match).
+ *
+ * The counts (including those of the reverse-complement hash) are
+ * determined here so that neither find_hits() nor find_matches_rescue()
+ * needs to search the index again.
+ */
+std::vector<RandstrobeLookup> lookup_randstrobes(
+    const std::vector<QueryRandstrobe>& query_randstrobes,
+    const StrobemerIndex& index,
+    bool use_mcs
+) {
+    std::vector<RandstrobeLookup> lookups;
+    lookups.reserve(query_randstrobes.size());
+    for (const auto &q : query_randstrobes) {
+        RandstrobeLookup lookup{index.end(), 0, false, false};
+        size_t partial_position = index.end();
+        if (use_mcs) {
+            std::tie(lookup.position, partial_position) = index.find_full_and_partial(q.hash);
+        } else {
+            lookup.position = index.find_full(q.hash);
+        }
+        // The filter conditions are the same as in is_filtered() and
+        // is_partial_filtered(), but use the counts instead of comparing
+        // hashes filter_cutoff entries ahead
+        if (lookup.position != index.end()) {
+            lookup.count = index.get_count_full(lookup.position);
+            lookup.is_filtered = lookup.count > index.filter_cutoff;
+            size_t position_revcomp = index.find_full(q.hash_revcomp);
+            if (position_revcomp != index.end()) {
+                lookup.count += index.get_count_full(position_revcomp);
+                lookup.is_filtered = lookup.count > index.filter_cutoff;
+            }
+        } else if (partial_position != index.end()) {
+            lookup.position = partial_position;
+            lookup.is_partial = true;
+            lookup.count = index.get_count_partial(lookup.position);
+            lookup.is_filtered = lookup.count > index.partial_filter_cutoff;
+            size_t position_revcomp = index.find_partial(q.hash_revcomp);
+            if (position_revcomp != index.end()) {
+                unsigned int count_revcomp = index.get_count_partial(position_revcomp);
+                lookup.is_filtered = lookup.is_filtered
+                    || count_revcomp > index.partial_filter_cutoff
+                    || lookup.count + count_revcomp > index.filter_cutoff;
+                lookup.count += count_revcomp;
+            }
+        }
+        lookups.push_back(lookup);
+    }
+    return lookups;
+}
+
 /*
  * Find a query’s hits, ignoring randstrobes that occur too often in the
  * reference (have a count above filter_cutoff).
@@ -206,6 +241,7 @@ robin_hood::unordered_map<unsigned int, std::vector<Match>> hits_to_matches(
  */
 std::tuple<int, int, bool, std::vector<Hit>> find_hits(
     const std::vector<QueryRandstrobe>& query_randstrobes,
+    const std::vector<RandstrobeLookup>& lookups,
     const StrobemerIndex& index,
     bool use_mcs
 ) {
@@ -213,27 +249,23 @@ std::tuple<int, int, bool, std::vector<Hit>> find_hits(
     // does not have to re-sort
     bool sorting_needed{use_mcs};
     std::vector<Hit> hits;
-    int nonrepetitive_hits = 0;
     int total_hits = 0;
     int partial_hits = 0;
-    for (const auto &q : query_randstrobes) {
-        size_t position = index.find_full(q.hash);
-        if (position != index.end()) {
-            total_hits++;
-            if (index.is_filtered(position, q.hash_revcomp)) {
-                continue;
-            }
-            hits.push_back(Hit{position, q.start, q.end, false});
-        } else if (use_mcs) {
-            size_t partial_pos = index.find_partial(q.hash);
-            if (partial_pos != index.end()) {
-                total_hits++;
-                if (index.is_partial_filtered(partial_pos, q.hash_revcomp)) {
-                    continue;
-                }
-                partial_hits++;
-                hits.push_back(Hit{partial_pos, q.start, q.start + index.k(), true});
-            }
+    for (size_t i = 0; i < query_randstrobes.size(); ++i) {
+        const auto& q = query_randstrobes[i];
+        const auto& lookup = lookups[i];
+        if (lookup.position == index.end()) {
+            continue;
+        }
+        total_hits++;
+        if (lookup.is_filtered) {
+            continue;
+        }
+        if (lookup.is_partial) {
+            partial_hits++;
+            hits.push_back(Hit{lookup.position, q.start, q.start + index.k(), true});
+        } else {
+            hits.push_back(Hit{lookup.position, q.start, q.end, false});
         }
     }
 
@@ -260,13 +292,16 @@ std::tuple<int, int, bool, std::vector<Hit>> find_hits(
  * Find a query’s NAMs, using also some of the randstrobes that occur more often
  * than filter_cutoff.
  *
+ * The randstrobes and their counts have already been looked up by
+ * lookup_randstrobes().
+ *
  * Return the number of hits and the vector of NAMs.
  */
 std::tuple<int, int, robin_hood::unordered_map<unsigned int, std::vector<Match>>> find_matches_rescue(
     const std::vector<QueryRandstrobe>& query_randstrobes,
+    const std::vector<RandstrobeLookup>& lookups,
     const StrobemerIndex& index,
-    unsigned int rescue_cutoff,
-    bool use_mcs
+    unsigned int rescue_cutoff
 ) {
     struct RescueHit {
         size_t position;
@@ -286,30 +321,19 @@ std::tuple<int, int, robin_hood::unordered_map<unsigned int, std::vector<Match>>
     int partial_hits = 0;
     std::vector<RescueHit> rescue_hits;
     rescue_hits.reserve(5000);
-    for (auto &qr : query_randstrobes) {
-        size_t position = index.find_full(qr.hash);
-        if (position != index.end()) {
-            unsigned int count = index.get_count_full(position);
-
-            size_t position_revcomp = index.find_full(qr.hash_revcomp);
-            if (position_revcomp != index.end()) {
-                count += index.get_count_full(position_revcomp);
-            }
-            RescueHit rh{position, count, qr.start, qr.end, false};
-            rescue_hits.push_back(rh);
+    for (size_t i = 0; i < query_randstrobes.size(); ++i) {
+        const auto& qr = query_randstrobes[i];
+        const auto& lookup = lookups[i];
+        if (lookup.position == index.end()) {
+            continue;
         }
-        else if (use_mcs) {
-            size_t partial_pos = index.find_partial(qr.hash);
-            if (partial_pos != index.end()) {
-                unsigned int partial_count = index.get_count_partial(partial_pos);
-                size_t position_revcomp = index.find_partial(qr.hash_revcomp);
-                if (position_revcomp != index.end()) {
-                    partial_count += index.get_count_partial(position_revcomp);
-                }
-                RescueHit rh{partial_pos, partial_count, qr.start, qr.start + index.k(), true};
-                rescue_hits.push_back(rh);
-                partial_hits++;
-            }
+        if (!lookup.is_partial) {
+            RescueHit rh{lookup.position, lookup.count, qr.start, qr.end, false};
+            rescue_hits.push_back(rh);
+        } else {
+            RescueHit rh{lookup.position, lookup.count, qr.start, qr.start + index.k(), true};
+            rescue_hits.push_back(rh);
+            partial_hits++;
         }
     }
     std::sort(rescue_hits.begin(), rescue_hits.end());
@@ -343,7 +367,207 @@ std::ostream& operator<<(std::ostream& os, const Match& match) {
 }
 
 
+/*
+ * Whether two NAMs project to the same locus, that is, whether they are on
+ * the same reference and strand and their projected reference start
+ * positions differ by at most *tolerance*
+ */
+bool is_same_locus(const Nam& a, const Nam& b, int tolerance) {
+    return a.ref_id == b.ref_id
+        && a.is_revcomp == b.is_revcomp
+        && std::abs(a.projected_ref_start() - b.projected_ref_start()) <= tolerance;
+}
+
+/*
+ * Merge NAMs that project to the same locus (see is_same_locus()). Examples
+ * are parts of one alignment that are separated by a cluster of mismatches.
+ * Extending each of them would only result in the same alignment again.
+ *
+ * The input must be sorted by score (highest first). The candidates for
+ * extension, that is, the NAMs whose score is at least dropoff times that of
+ * the first one, are grouped by locus, and only the highest-scoring NAM of
+ * each group is kept. All other NAMs at the locus of a group (including
+ * those below the dropoff) are merged into it: Their n_matches are added to
+ * the kept NAM, which is also extended to cover those on the same diagonal.
+ * Afterwards, the NAMs are sorted by score again (the relative order of NAMs
+ * with the same score is preserved).
+ *
+ * Return the number of NAMs that were removed.
+ */
+size_t merge_nams_at_same_locus(std::vector<Nam>& nams, int tolerance, float dropoff) {
+    if (nams.size() < 2) {
+        return 0;
+    }
+    const float min_score = nams[0].score() * dropoff;
+    size_t n_candidates = 0;
+    while (n_candidates < nams.size() && nams[n_candidates].score() >= min_score) {
+        ++n_candidates;
+    }
+    // The key consists of reference id, strand and projected reference start
+    // (in that order), so NAMs on the same reference and strand have keys that
+    // differ by the distance of their projected starts
+    auto locus_key = [](const Nam& nam) -> uint64_t {
+        return (uint64_t(nam.ref_id) << 33) | (uint64_t(nam.is_revcomp) << 32) | uint32_t(nam.projected_ref_start());
+    };
+    std::vector<bool> is_changed(n_candidates, false);
+    size_t n_merged = 0;
+    auto merge = [&](size_t kept, size_t other) {
+        Nam& merged = nams[kept];
+        Nam& nam = nams[other];
+        if (nam.ref_start - nam.query_start == merged.ref_start - merged.query_start) {
+            merged.query_start = std::min(merged.query_start, nam.query_start);
+            merged.query_end = std::max(merged.query_end, nam.query_end);
+            merged.ref_start = std::min(merged.ref_start, nam.ref_start);
+            merged.ref_end = std::max(merged.ref_end, nam.ref_end);
+        }
+        merged.n_matches += nam.n_matches;
+        is_changed[kept] = true;
+        // Mark for removal
+        nam.n_matches = 0;
+        ++n_merged;
+    };
+
+    // Group the candidates by locus
+    std::vector<std::pair<uint64_t, uint32_t>> loci(n_candidates);
+    for (size_t i = 0; i < n_candidates; ++i) {
+        loci[i] = {locus_key(nams[i]), i};
+    }
+    std::sort(loci.begin(), loci.end());
+    // Key of the first NAM of each group and index of the kept NAM
+    std::vector<std::pair<uint64_t, uint32_t>> groups;
+    size_t group_start = 0;
+    for (size_t i = 1; i <= loci.size(); ++i) {
+        if (i < loci.size() && loci[i].first - loci[group_start].first <= uint64_t(tolerance)) {
+            continue;
+        }
+        // The NAM with the smallest index has the highest score
+        uint32_t kept = loci[group_start].second;
+        for (size_t j = group_start + 1; j < i; ++j) {
+            kept = std::min(kept, loci[j].second);
+        }
+        for (size_t j = group_start; j < i; ++j) {
+            if (loci[j].second != kept) {
+                merge(kept, loci[j].second);
+            }
+        }
+        groups.emplace_back(loci[group_start].first, kept);
+        group_start = i;
+    }
+
+    // Merge the remaining NAMs into a group at the same locus, if there is one
+    for (size_t i = n_candidates; i < nams.size(); ++i) {
+        const uint64_t key = locus_key(nams[i]);
+        auto it = std::upper_bound(groups.begin(), groups.end(), std::make_pair(key, UINT32_MAX));
+        if (it != groups.begin() && key - (it - 1)->first <= uint64_t(tolerance)) {
+            merge((it - 1)->second, i);
+        } else if (it != groups.end() && it->first - key <= uint64_t(tolerance)) {
+            merge(it->second, i);
+        }
+    }
+    if (n_merged == 0) {
+        return 0;
+    }
+
+    // Only the scores of the changed NAMs need to be compared again: They
+    // are taken out, sorted and then merged back into the rest
+    std::vector<Nam> changed_nams;
+    for (size_t i = 0; i < n_candidates; ++i) {
+        if (is_changed[i]) {
+            changed_nams.push_back(nams[i]);
+            nams[i].n_matches = 0;
+        }
+    }
+    nams.erase(std::remove_if(nams.begin(), nams.end(), [](const Nam& nam) { return nam.n_matches == 0; }), nams.end());
+    auto by_score = [](const Nam& a, const Nam& b) { return a.score() > b.score(); };
+    std::stable_sort(changed_nams.begin(), changed_nams.end(), by_score);
+    const size_t n_unchanged = nams.size();
+    nams.insert(nams.end(), changed_nams.begin(), changed_nams.end());
+    std::inplace_merge(nams.begin(), nams.begin() + n_unchanged, nams.end(), by_score);
+
+    return n_merged;
+}
+
+/*
+ * Find the highest-scoring chain of collinear NAMs (same reference, same
+ * orientation, increasing query and reference coordinates, similar diagonal).
+ * This is used for long reads, whose NAMs are found segment by segment.
+ *
+ * The chain score is the sum of the NAM scores minus the diagonal shifts
+ * between consecutive NAMs. Only a fixed number of predecessors is
+ * considered for each NAM, so the running time is linear in the number of
+ * NAMs.
+ *
+ * The second-best score is that of the best chain ending in a NAM that does
+ * not overlap the best chain on the reference. It is used for the mapping
+ * quality.
+ *
+ * The input NAMs are re-ordered.
+ */
+Chain chain_nams(std::vector<Nam>& nams) {
+    constexpr size_t max_lookback = 50;
+    Chain chain;
+    if (nams.empty()) {
+        return chain;
+    }
+    std::sort(nams.begin(), nams.end(), [](const Nam& a, const Nam& b) {
+        if (a.is_revcomp != b.is_revcomp) {
+            return a.is_revcomp < b.is_revcomp;
+        }
+        return std::tie(a.ref_id, a.query_start, a.ref_start) < std::tie(b.ref_id, b.query_start, b.ref_start);
+    });
+
+    std::vector<float> scores(nams.size());
+    std::vector<int> predecessors(nams.size(), -1);
+    size_t best_end = 0;
+    for (size_t j = 0; j < nams.size(); j++) {
+        const Nam& b = nams[j];
+        scores[j] = b.score();
+        for (size_t i = j; i > 0 && j - i < max_lookback; i--) {
+            const Nam& a = nams[i - 1];
+            if (a.ref_id != b.ref_id || a.is_revcomp != b.is_revcomp) {
+                break;
+            }
+            if (a.query_start >= b.query_start || a.ref_start > b.ref_start) {
+                continue;
+            }
+            int diagonal_shift = std::abs((b.ref_start - b.query_start) - (a.ref_start - a.query_start));
+            if (diagonal_shift > 50 + (b.query_start - a.query_start) / 10) {
+                continue;
+            }
+            float score = scores[i - 1] + b.score() - diagonal_shift;
+            if (score > scores[j]) {
+                scores[j] = score;
+                predecessors[j] = i - 1;
+            }
+        }
+        if (scores[j] > scores[best_end]) {
+            best_end = j;
+        }
+    }
+
+    for (int i = best_end; i != -1; i = predecessors[i]) {
+        chain.nams.push_back(nams[i]);
+    }
+    std::reverse(chain.nams.begin(), chain.nams.end());
+    chain.score = scores[best_end];
+
+    const Nam& first = chain.nams.front();
+    const Nam& last = chain.nams.back();
+    for (size_t j = 0; j < nams.size(); j++) {
+        const Nam& nam = nams[j];
+        bool overlaps = nam.ref_id == first.ref_id
+            && nam.is_revcomp == first.is_revcomp
+            && nam.ref_end > first.ref_start
+            && nam.ref_start < last.ref_end;
+        if (!overlaps) {
+            chain.second_best_score = std::max(chain.second_best_score, scores[j]);
+        }
+    }
+
+    return chain;
+}
+
 std::ostream& operator<<(std::ostream& os, const Nam& n) {
-    os << "Nam(ref_id=" << n.ref_id << ", query: " << n.query_start << ".." << n.query_end << ", ref: " << n.ref_start << ".." << n.ref_end << ", rc=" << static_cast<int>(n.is_revcomp) << ", score=" << n.score << ")";
+    os << "Nam(ref_id=" << n.ref_id << ", query: " << n.query_start << ".." << n.query_end << ", ref: " << n.ref_start << ".." << n.ref_end << ", rc=" << static_cast<int>(n.is_revcomp) << ", score=" << n.score() << ")";
     return os;
 }
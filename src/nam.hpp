@@ -26,20 +26,19 @@ std::ostream& operator<<(std::ostream& os, const Match& match);
 
 
 // Non-overlapping approximate match
+//
+// NAMs are sorted, shuffled and paired up for every read, so this is kept
+// small. The score is not stored, but computed from the other fields.
 struct Nam {
-    int nam_id;
     int query_start;
     int query_end;
-    int query_prev_match_startpos;
     int ref_start;
     int ref_end;
-    int ref_prev_match_startpos;
-    int n_matches = 0;
     int ref_id;
-    float score;
-//    unsigned int previous_query_start;
-//    unsigned int previous_ref_start;
-    bool is_revcomp = false;
+    uint32_t n_matches : 31;
+    uint32_t is_revcomp : 1;
+
+    Nam() : n_matches(0), is_revcomp(0) { }
 
     int ref_span() const {
         return ref_end - ref_start;
@@ -52,21 +51,53 @@ struct Nam {
     int projected_ref_start() const {
         return std::max(0, ref_start - query_start);
     }
+
+    float score() const {
+        int max_span = std::max(query_span(), ref_span());
+        int min_span = std::min(query_span(), ref_span());
+        // this is really just n_matches * (min_span - (offset_in_span))
+        return (2 * min_span - max_span) > 0 ? static_cast<float>(n_matches * (2 * min_span - max_span)) : 1;
+    }
 };
 
+static_assert(sizeof(Nam) == 24);
+
 std::ostream& operator<<(std::ostream& os, const Nam& nam);
 
+/*
+ * Result of looking up a query randstrobe in the index. This is computed
+ * once per randstrobe and then used both for finding hits and for rescue.
+ */
+struct RandstrobeLookup {
+    // Position of the first entry with the same hash (index.end() if there
+    // is none). If is_partial is set, this refers to the main hash only.
+    size_t position;
+    // Number of entries with the same hash plus those with the same
+    // reverse-complement hash
+    unsigned int count;
+    bool is_partial;
+    // Whether the randstrobe occurs too often to be used as a regular hit
+    bool is_filtered;
+};
+
+std::vector<RandstrobeLookup> lookup_randstrobes(
+    const std::vector<QueryRandstrobe>& query_randstrobes,
+    const StrobemerIndex& index,
+    bool use_mcs
+);
+
 std::tuple<int, int, bool, std::vector<Hit>> find_hits(
     const std::vector<QueryRandstrobe>& query_randstrobes,
+    const std::vector<RandstrobeLookup>& lookups,
     const StrobemerIndex& index,
     bool use_mcs
 );
 
 std::tuple<int, int, robin_hood::unordered_map<unsigned int, std::vector<Match>>> find_matches_rescue(
     const std::vector<QueryRandstrobe>& query_randstrobes,
+    const std::vector<RandstrobeLookup>& lookups,
     const StrobemerIndex& index,
-    unsigned int rescue_cutoff,
-    bool use_mcs
+    unsigned int rescue_cutoff
 );
 
 void merge_matches_into_nams(
@@ -82,4 +113,16 @@ robin_hood::unordered_map<unsigned int, std::vector<Match>> hits_to_matches(
     const StrobemerIndex& index
 );
 
+bool is_same_locus(const Nam& a, const Nam& b, int tolerance);
+size_t merge_nams_at_same_locus(std::vector<Nam>& nams, int tolerance, float dropoff);
+
+// Collinear NAMs on the same reference and strand
+struct Chain {
+    std::vector<Nam> nams;  // sorted by query start
+    float score{0};
+    float second_best_score{0};  // score of the best chain elsewhere
+};
+
+Chain chain_nams(std::vector<Nam>& nams);
+
 #endif
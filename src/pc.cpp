@@ -9,24 +9,29 @@
 #include <iostream>
 #include <chrono>
 #include <queue>
+#include <algorithm>
+#include <cmath>
 
 #include "timer.hpp"
 #include "robin_hood.h"
 #include "index.hpp"
 #include "kseq++/kseq++.hpp"
 #include "sam.hpp"
+#include "sequtils.hpp"
 
 // checks if two read names are the same ignoring /1 suffix on the first one
-// and /2 on the second one (if present)
+// and /2 on the second one (if present on either or both of them)
 bool same_name(const std::string& n1, const std::string& n2) {
-    if (n1.length() != n2.length()) return false;
-    if (n1.length() <= 2) return n1 == n2;
-    size_t i = 0;
-    for ( ; i < n1.length() - 1; ++i) {
-        if (n1[i] != n2[i]) return false;
-    }
-    if (n1[i - 1] == '/' && n1[i] == '1' && n2[i] == '2') return true;
-    return n1[i] == n2[i];
+    auto base_length = [](const std::string& name, char mate) {
+        auto n = name.length();
+        if (n > 2 && name[n - 2] == '/' && name[n - 1] == mate) {
+            return n - 2;
+        }
+        return n;
+    };
+    auto len1 = base_length(n1, '1');
+    auto len2 = base_length(n2, '2');
+    return len1 == len2 && n1.compare(0, len1, n2, 0, len2) == 0;
 }
 
 // distribute_interleaved implements the 'interleaved' format:
@@ -65,28 +70,248 @@ void distribute_interleaved(
     }
 }
 
+/*
+ * Check that the records read from the R1 and R2 files can be paired up,
+ * that is, that there are as many of each and that their names match
+ * according to same_name().
+ */
+void check_mates(const std::vector<klibpp::KSeq>& records1, const std::vector<klibpp::KSeq>& records2) {
+    if (records1.size() != records2.size()) {
+        throw InvalidFile("The files with R1 and R2 reads contain a different number of reads");
+    }
+    for (size_t i = 0; i < records1.size(); ++i) {
+        if (!same_name(records1[i].name, records2[i].name)) {
+            throw InvalidFile(
+                "Read names of R1 and R2 do not match: '" + records1[i].name + "' and '" + records2[i].name + "'"
+            );
+        }
+    }
+}
+
+ChunkReader::ChunkReader(RewindableFile& file, size_t chunk_size, std::chrono::milliseconds max_delay)
+    : file(file)
+    , chunk_size(chunk_size)
+    , max_delay(max_delay)
+    , thread(&ChunkReader::run, this)
+{ }
+
+ChunkReader::~ChunkReader() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+void ChunkReader::run() {
+    if (max_delay.count() > 0) {
+        run_streaming();
+        return;
+    }
+    while (true) {
+        std::vector<klibpp::KSeq> records;
+        std::exception_ptr read_error;
+        try {
+            records = file.stream().read(chunk_size);
+        } catch (...) {
+            read_error = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return chunks.size() < max_queued_chunks || stop; });
+        if (stop) {
+            return;
+        }
+        if (read_error) {
+            error = read_error;
+        } else if (records.empty()) {
+            eof = true;
+        } else {
+            chunks.push_back(std::move(records));
+        }
+        lock.unlock();
+        cv.notify_all();
+        if (read_error || eof) {
+            return;
+        }
+    }
+}
+
+std::vector<klibpp::KSeq> ChunkReader::next() {
+    std::unique_lock<std::mutex> lock(mtx);
+    cv.wait(lock, [this] { return !chunks.empty() || eof || error; });
+    if (chunks.empty()) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return {};
+    }
+    auto records = std::move(chunks.front());
+    chunks.pop_front();
+    lock.unlock();
+    cv.notify_all();
+    return records;
+}
+
+/* Read one record at a time so that each is available as soon as possible */
+void ChunkReader::run_streaming() {
+    while (true) {
+        klibpp::KSeq record;
+        bool have_record = false;
+        std::exception_ptr read_error;
+        try {
+            have_record = static_cast<bool>(file.stream() >> record);
+        } catch (...) {
+            read_error = std::current_exception();
+        }
+        auto arrival_time = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return records.size() < max_queued_chunks * chunk_size || stop; });
+        if (stop) {
+            return;
+        }
+        if (read_error) {
+            error = read_error;
+        } else if (!have_record) {
+            eof = true;
+        } else {
+            records.push_back(std::move(record));
+            arrival_times.push_back(arrival_time);
+        }
+        lock.unlock();
+        cv.notify_all();
+        if (read_error || eof) {
+            return;
+        }
+    }
+}
+
+std::vector<klibpp::KSeq> ChunkReader::next_batch(std::vector<time_point>& batch_arrival_times, size_t n_records) {
+    assert(max_delay.count() > 0);
+    const size_t n = n_records > 0 ? n_records : chunk_size;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (records.size() < n && !eof && !error) {
+        if (n_records == 0 && !records.empty()) {
+            auto deadline = arrival_times.front() + max_delay;
+            if (std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            cv.wait_until(lock, deadline);
+        } else {
+            cv.wait(lock);
+        }
+    }
+    // A batch of the requested size cannot be completed after an error
+    if (error && (records.empty() || (n_records > 0 && records.size() < n_records))) {
+        std::rethrow_exception(error);
+    }
+    size_t count = std::min(n, records.size());
+    std::vector<klibpp::KSeq> batch(
+        std::make_move_iterator(records.begin()), std::make_move_iterator(records.begin() + count)
+    );
+    records.erase(records.begin(), records.begin() + count);
+    batch_arrival_times.assign(arrival_times.begin(), arrival_times.begin() + count);
+    arrival_times.erase(arrival_times.begin(), arrival_times.begin() + count);
+    lock.unlock();
+    cv.notify_all();
+    return batch;
+}
+
 size_t InputBuffer::read_records(
     std::vector<klibpp::KSeq> &records1,
     std::vector<klibpp::KSeq> &records2,
     std::vector<klibpp::KSeq> &records3,
-    int to_read
+    int to_read,
+    std::vector<ChunkReader::time_point>* arrival_times
+) {
+    // Acquire a unique lock on the mutex
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    if (error) {
+        records1.clear();
+        records2.clear();
+        records3.clear();
+        finished_reading = true;
+        return chunk_index;
+    }
+    while (true) {
+        size_t current_chunk_index = read_chunk(records1, records2, records3, to_read, arrival_times);
+        // Skip chunks that belong to other shards
+        if (current_chunk_index % n_shards == shard_index || finished_reading) {
+            return current_chunk_index;
+        }
+    }
+}
+
+/*
+ * Read the next chunk (the lock must be held) and return its index
+ */
+size_t InputBuffer::read_chunk(
+    std::vector<klibpp::KSeq> &records1,
+    std::vector<klibpp::KSeq> &records2,
+    std::vector<klibpp::KSeq> &records3,
+    int to_read,
+    std::vector<ChunkReader::time_point>* arrival_times
 ) {
     records1.clear();
     records2.clear();
     records3.clear();
-    // Acquire a unique lock on the mutex
-    std::unique_lock<std::mutex> unique_lock(mtx);
     if (to_read == -1) {
         to_read = chunk_size;
     }
-    if (this->is_interleaved) {
-        auto records = ks1->stream().read(to_read*2);
-        distribute_interleaved(records, records1, records2, records3, lookahead1);
-    } else if (!ks2) {
-        records3 = ks1->stream().read(to_read);
-    } else {
-        records1 = ks1->stream().read(to_read);
-        records2 = ks2->stream().read(to_read);
+    if (arrival_times) {
+        arrival_times->clear();
+    }
+    std::vector<ChunkReader::time_point> batch_arrival_times;
+    const bool low_latency = max_batch_delay.count() > 0;
+    // Record an error while still holding the lock so that no other worker
+    // reads the following records under the same chunk index
+    try {
+        if (this->is_interleaved) {
+            auto records = ks1->stream().read(to_read*2);
+            distribute_interleaved(records, records1, records2, records3, lookahead1);
+        } else if (!ks2) {
+            if (to_read == chunk_size && !reader1) {
+                reader1 = make_reader(*ks1);
+            }
+            if (reader1 && low_latency) {
+                records3 = reader1->next_batch(batch_arrival_times);
+            } else if (reader1) {
+                assert(to_read == chunk_size);
+                records3 = reader1->next();
+            } else {
+                records3 = ks1->stream().read(to_read);
+            }
+        } else {
+            if (to_read == chunk_size && !reader1) {
+                reader1 = make_reader(*ks1);
+                reader2 = make_reader(*ks2);
+            }
+            if (reader1 && low_latency) {
+                // Take as many R2 reads as there are R1 reads in the batch.
+                // A pair has arrived when its later mate has.
+                records1 = reader1->next_batch(batch_arrival_times);
+                std::vector<ChunkReader::time_point> arrival_times2;
+                records2 = reader2->next_batch(arrival_times2, records1.size());
+                for (size_t i = 0; i < std::min(batch_arrival_times.size(), arrival_times2.size()); ++i) {
+                    batch_arrival_times[i] = std::max(batch_arrival_times[i], arrival_times2[i]);
+                }
+            } else if (reader1) {
+                assert(to_read == chunk_size);
+                records1 = reader1->next();
+                records2 = reader2->next();
+            } else {
+                records1 = ks1->stream().read(to_read);
+                records2 = ks2->stream().read(to_read);
+            }
+            check_mates(records1, records2);
+        }
+    } catch (const std::runtime_error&) {
+        error = std::current_exception();
+        finished_reading = true;
+        throw;
+    }
+    if (arrival_times) {
+        *arrival_times = std::move(batch_arrival_times);
     }
     size_t current_chunk_index = chunk_index;
     chunk_index++;
@@ -95,13 +320,13 @@ size_t InputBuffer::read_records(
         finished_reading = true;
     }
 
-    unique_lock.unlock();
-
     return current_chunk_index;
 }
 
 void InputBuffer::rewind_reset() {
     std::unique_lock<std::mutex> unique_lock(mtx);
+    reader1.reset();
+    reader2.reset();
     ks1->rewind();
     if (ks2) {
         ks2->rewind();
@@ -110,22 +335,198 @@ void InputBuffer::rewind_reset() {
     chunk_index = 0;
 }
 
+/*
+ * Start reading and decompressing the first chunks in the background (not
+ * for interleaved input)
+ */
+void InputBuffer::start_reading() {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    if (!ks1 || is_interleaved || reader1) {
+        return;
+    }
+    reader1 = make_reader(*ks1);
+    if (ks2) {
+        reader2 = make_reader(*ks2);
+    }
+}
+
+std::unique_ptr<ChunkReader> InputBuffer::make_reader(RewindableFile& file) const {
+    return std::make_unique<ChunkReader>(file, chunk_size, max_batch_delay);
+}
+
+/*
+ * Read and discard the chunks before chunk n (as when resuming from a
+ * checkpoint), no matter which shard they belong to. Return the number of
+ * reads skipped.
+ */
+size_t InputBuffer::skip_chunks(size_t n) {
+    std::vector<klibpp::KSeq> records1;
+    std::vector<klibpp::KSeq> records2;
+    std::vector<klibpp::KSeq> records3;
+    size_t n_reads = 0;
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    while (chunk_index < n) {
+        read_chunk(records1, records2, records3, -1, nullptr);
+        if (records1.empty() && records3.empty()) {
+            throw InvalidFile("Input has fewer reads than recorded in the checkpoint");
+        }
+        n_reads += records1.size() + records2.size() + records3.size();
+    }
+    return n_reads;
+}
+
+/*
+ * Only return every n_shards-th chunk, starting at chunk shard_index
+ */
+void InputBuffer::set_shard(size_t shard_index, size_t n_shards) {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    this->shard_index = shard_index;
+    this->n_shards = n_shards;
+}
+
+/*
+ * Enable low-latency mode (not for interleaved input), in which a partial
+ * chunk is returned once its first read has waited for max_batch_delay.
+ * Must be called before reading starts.
+ */
+void InputBuffer::set_max_batch_delay(std::chrono::milliseconds max_batch_delay) {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    assert(!reader1 && !is_interleaved);
+    this->max_batch_delay = max_batch_delay;
+}
+
+void InputBuffer::set_error(std::exception_ptr e) {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    if (!error) {
+        error = e;
+    }
+    finished_reading = true;
+}
+
+void InputBuffer::rethrow_if_error() {
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/*
+ * Start checkpointing. The checkpoint describes what has already been
+ * written to the output (possibly in a previous run).
+ */
+void OutputBuffer::enable_checkpoints(const std::string& path, std::chrono::duration<double> interval, Checkpoint checkpoint) {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    checkpoint_path = path;
+    checkpoint_interval = interval;
+    next_chunk_index = checkpoint.n_chunks;
+    this->checkpoint = std::move(checkpoint);
+    last_checkpoint = std::chrono::steady_clock::now();
+}
+
+/* Write and flush each chunk as soon as it is ready, and record latencies */
+void OutputBuffer::enable_low_latency() {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    assert(!checkpoints_enabled());
+    low_latency = true;
+}
+
+/* Expect only the chunks that InputBuffer::set_shard() lets through */
+void OutputBuffer::set_shard(size_t shard_index, size_t n_shards) {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    next_chunk_index = shard_index;
+    chunk_step = n_shards;
+}
+
 void OutputBuffer::output_records(std::string chunk, size_t chunk_index) {
+    output_records(std::move(chunk), chunk_index, AlignmentStatistics{}, {});
+}
+
+/*
+ * Output a chunk of records. If checkpointing is enabled, statistics and
+ * abundances must be those of this chunk only; they are added to the
+ * checkpoint once the chunk has been written. In low-latency mode,
+ * arrival_times are the times at which the reads of the chunk were read.
+ */
+void OutputBuffer::output_records(
+    std::string chunk,
+    size_t chunk_index,
+    const AlignmentStatistics& statistics,
+    std::vector<double> abundances,
+    const std::vector<ChunkReader::time_point>& arrival_times
+) {
     std::unique_lock<std::mutex> unique_lock(mtx);
+    if (low_latency) {
+        out << chunk;
+        out.flush();
+        auto now = std::chrono::steady_clock::now();
+        for (auto arrival_time : arrival_times) {
+            latencies.add(now - arrival_time);
+        }
+        return;
+    }
 
     // Ensure we print the chunks in the order in which they were read
     assert(chunks.count(chunk_index) == 0);
     chunks.emplace(std::make_pair(chunk_index, chunk));
+    if (checkpoints_enabled()) {
+        chunk_progress.emplace(chunk_index, std::make_pair(statistics, std::move(abundances)));
+    }
+    bool wrote_chunks = false;
     while (true) {
         const auto& item = chunks.find(next_chunk_index);
         if (item == chunks.end()) {
             break;
         }
         out << item->second;
+        if (checkpoints_enabled()) {
+            auto progress = chunk_progress.find(next_chunk_index);
+            checkpoint.output_size += item->second.size();
+            checkpoint.statistics += progress->second.first;
+            auto& chunk_abundances = progress->second.second;
+            checkpoint.abundances.resize(std::max(checkpoint.abundances.size(), chunk_abundances.size()), 0);
+            for (size_t i = 0; i < chunk_abundances.size(); ++i) {
+                checkpoint.abundances[i] += chunk_abundances[i];
+            }
+            chunk_progress.erase(progress);
+            wrote_chunks = true;
+        }
         chunks.erase(item);
-        next_chunk_index++;
+        next_chunk_index += chunk_step;
+    }
+    if (wrote_chunks && std::chrono::steady_clock::now() - last_checkpoint >= checkpoint_interval) {
+        unique_lock.unlock();
+        write_checkpoint();
     }
-    unique_lock.unlock();
+}
+
+/* Flush the output and record the chunks written so far in the checkpoint file */
+void OutputBuffer::write_checkpoint() {
+    std::unique_lock<std::mutex> unique_lock(mtx);
+    if (!checkpoints_enabled()) {
+        return;
+    }
+    out.flush();
+    checkpoint.n_chunks = next_chunk_index;
+    checkpoint.write(checkpoint_path);
+    last_checkpoint = std::chrono::steady_clock::now();
+}
+
+void LatencyHistogram::add(std::chrono::duration<double> latency) {
+    size_t bin = std::min(static_cast<size_t>(latency.count() / bin_width), counts.size() - 1);
+    counts[bin]++;
+    n++;
+    max_latency = std::max(max_latency, latency);
+}
+
+std::chrono::duration<double> LatencyHistogram::percentile(double p) const {
+    uint64_t target = std::max<uint64_t>(1, std::ceil(p * n));
+    uint64_t cumulative = 0;
+    for (size_t bin = 0; bin < counts.size(); ++bin) {
+        cumulative += counts[bin];
+        if (cumulative >= target) {
+            return std::min(max_latency, std::chrono::duration<double>((bin + 1) * bin_width));
+        }
+    }
+    return max_latency;
 }
 
 
@@ -144,13 +545,23 @@ void perform_task(
 ) {
     bool eof = false;
     Aligner aligner{aln_params};
+    uint64_t aligner_calls = 0;
     std::minstd_rand random_engine;
+    const bool checkpoints = output_buffer.checkpoints_enabled();
+    std::vector<ChunkReader::time_point> arrival_times;
     while (!eof) {
         std::vector<klibpp::KSeq> records1;
         std::vector<klibpp::KSeq> records2;
         std::vector<klibpp::KSeq> records3;
         Timer timer;
-        auto chunk_index = input_buffer.read_records(records1, records2, records3);
+        size_t chunk_index;
+        try {
+            chunk_index = input_buffer.read_records(records1, records2, records3, -1, &arrival_times);
+        } catch (const std::runtime_error&) {
+            // Let the main thread report the error once all workers are done
+            input_buffer.set_error(std::current_exception());
+            break;
+        }
         statistics.tot_read_file += timer.duration();
         assert(records1.size() == records2.size());
         if (records1.empty()
@@ -163,6 +574,15 @@ void perform_task(
         sam_out.reserve(7*map_param.r * (records1.size() + records3.size()));
         Sam sam{sam_out, references, map_param.cigar_ops, read_group_id, map_param.output_unmapped, map_param.details, map_param.fastq_comments};
         InsertSizeDistribution isize_est;
+        // With checkpoints, statistics and abundances are collected per chunk
+        // because they are only added to the checkpoint once the chunk has
+        // been written
+        AlignmentStatistics chunk_statistics;
+        std::vector<double> chunk_abundances;
+        if (checkpoints) {
+            chunk_abundances.assign(abundances.size(), 0);
+        }
+        auto& target_abundances = checkpoints ? chunk_abundances : abundances;
         // Use chunk index as random seed for reproducibility
         random_engine.seed(chunk_index);
         for (size_t i = 0; i < records1.size(); ++i) {
@@ -170,22 +590,30 @@ void perform_task(
             auto record2 = records2[i];
             to_uppercase(record1.seq);
             to_uppercase(record2.seq);
-            align_or_map_paired(record1, record2, sam, sam_out, statistics, isize_est, aligner,
-                        map_param, index_parameters, references, index, random_engine, abundances);
-            statistics.n_reads += 2;
+            align_or_map_paired(record1, record2, sam, sam_out, chunk_statistics, isize_est, aligner,
+                        map_param, index_parameters, references, index, random_engine, target_abundances);
+            chunk_statistics.n_reads += 2;
         }
         for (size_t i = 0; i < records3.size(); ++i) {
             auto record = records3[i];
-            align_or_map_single(record, sam, sam_out, statistics, aligner, map_param, index_parameters, references, index, random_engine, abundances);
-            statistics.n_reads++;
+            align_or_map_single(record, sam, sam_out, chunk_statistics, aligner, map_param, index_parameters, references, index, random_engine, target_abundances);
+            chunk_statistics.n_reads++;
         }
+        chunk_statistics.tot_aligner_calls = aligner.calls_count() - aligner_calls;
+        aligner_calls = aligner.calls_count();
+        statistics += chunk_statistics;
 
-
-        if (map_param.output_format != OutputFormat::Abundance) {
+        if (checkpoints) {
+            for (size_t i = 0; i < chunk_abundances.size(); ++i) {
+                abundances[i] += chunk_abundances[i];
+            }
+            output_buffer.output_records(std::move(sam_out), chunk_index, chunk_statistics, std::move(chunk_abundances));
+        } else if (output_buffer.low_latency) {
+            output_buffer.output_records(std::move(sam_out), chunk_index, chunk_statistics, {}, arrival_times);
+        } else if (map_param.output_format != OutputFormat::Abundance) {
             output_buffer.output_records(std::move(sam_out), chunk_index);
             assert(sam_out == "");
         }
     }
-    statistics.tot_aligner_calls += aligner.calls_count();
     done = true;
 }
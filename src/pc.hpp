@@ -12,11 +12,69 @@
 #include <sstream>
 #include <unordered_map>
 #include <optional>
+#include <deque>
+#include <memory>
+#include <exception>
 
 #include "index.hpp"
 #include "aln.hpp"
 #include "refs.hpp"
 #include "fastq.hpp"
+#include "checkpoint.hpp"
+
+/*
+ * Reads chunks of records from a FASTQ file in a background thread.
+ *
+ * Decompression and parsing of the file happen in that thread, which reads
+ * ahead by up to max_queued_chunks chunks.
+ *
+ * If max_delay is nonzero, records are instead passed on one by one as they
+ * arrive, and next_batch() returns a partial chunk once its first record has
+ * waited for max_delay.
+ */
+class ChunkReader {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    ChunkReader(RewindableFile& file, size_t chunk_size, std::chrono::milliseconds max_delay = std::chrono::milliseconds{0});
+    ~ChunkReader();
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    /*
+     * Return the next chunk. The chunk is empty if the end of the file has
+     * been reached. An exception that occurred while reading is rethrown here.
+     */
+    std::vector<klibpp::KSeq> next();
+
+    /*
+     * Return the next batch of records (only if max_delay is nonzero) and the
+     * times at which they were read. If n_records is zero, the batch is a
+     * full chunk or whatever was read before its first record has waited for
+     * max_delay. Otherwise, it has exactly n_records records (fewer only at
+     * the end of the file).
+     */
+    std::vector<klibpp::KSeq> next_batch(std::vector<time_point>& arrival_times, size_t n_records = 0);
+
+private:
+    void run();
+    void run_streaming();
+
+    static constexpr size_t max_queued_chunks = 4;
+    RewindableFile& file;
+    const size_t chunk_size;
+    const std::chrono::milliseconds max_delay;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::vector<klibpp::KSeq>> chunks;
+    // Records and their arrival times if max_delay is nonzero
+    std::deque<klibpp::KSeq> records;
+    std::deque<time_point> arrival_times;
+    bool eof{false};
+    bool stop{false};
+    std::exception_ptr error;
+    std::thread thread;
+};
 
 class InputBuffer {
 
@@ -32,19 +90,69 @@ public:
 
     input_stream_t ks1;
     input_stream_t ks2;
+    // Background readers for single-end input and for paired-end input
+    // from two files (R1 and R2 are then read concurrently). They are
+    // started by start_reading() or on the first read of a full chunk.
+    std::unique_ptr<ChunkReader> reader1;
+    std::unique_ptr<ChunkReader> reader2;
     std::optional<klibpp::KSeq> lookahead1;
     bool finished_reading{false};
     int chunk_size;
     size_t chunk_index{0};
+    size_t shard_index{0};
+    size_t n_shards{1};
+    // Low-latency mode: maximum time the first read of a chunk waits for
+    // the chunk to fill up (0 if disabled)
+    std::chrono::milliseconds max_batch_delay{0};
     bool is_interleaved{false};
+    // Set by a worker that encountered an error
+    std::exception_ptr error;
 
     void rewind_reset();
+    void start_reading();
+    size_t skip_chunks(size_t n);
+    void set_shard(size_t shard_index, size_t n_shards);
+    void set_max_batch_delay(std::chrono::milliseconds max_batch_delay);
     size_t read_records(
         std::vector<klibpp::KSeq> &records1,
         std::vector<klibpp::KSeq> &records2,
         std::vector<klibpp::KSeq> &records3,
-        int read_count=-1
+        int read_count=-1,
+        std::vector<ChunkReader::time_point>* arrival_times=nullptr
+    );
+    void set_error(std::exception_ptr e);
+    void rethrow_if_error();
+
+private:
+    size_t read_chunk(
+        std::vector<klibpp::KSeq> &records1,
+        std::vector<klibpp::KSeq> &records2,
+        std::vector<klibpp::KSeq> &records3,
+        int to_read,
+        std::vector<ChunkReader::time_point>* arrival_times
     );
+    std::unique_ptr<ChunkReader> make_reader(RewindableFile& file) const;
+};
+
+
+/*
+ * Histogram of latencies with a resolution of 0.1 ms, which gives
+ * percentiles in constant memory. Latencies of 10 s or more all end up in
+ * the last bin.
+ */
+class LatencyHistogram {
+public:
+    void add(std::chrono::duration<double> latency);
+    size_t size() const { return n; }
+    // Return the smallest latency that at least the fraction p of all latencies do not exceed
+    std::chrono::duration<double> percentile(double p) const;
+    std::chrono::duration<double> max() const { return max_latency; }
+
+private:
+    static constexpr double bin_width = 1e-4;  // seconds
+    std::vector<uint64_t> counts = std::vector<uint64_t>(100000, 0);
+    size_t n{0};
+    std::chrono::duration<double> max_latency{0};
 };
 
 
@@ -57,8 +165,34 @@ public:
     std::ostream &out;
     std::unordered_map<size_t, std::string> chunks;
     size_t next_chunk_index{0};
-
+    size_t chunk_step{1};  // Distance between the indices of consecutive chunks
+
+    // Checkpointing is enabled if checkpoint_path is not empty
+    std::string checkpoint_path;
+    std::chrono::duration<double> checkpoint_interval{0};
+    Checkpoint checkpoint;
+    std::unordered_map<size_t, std::pair<AlignmentStatistics, std::vector<double>>> chunk_progress;
+    std::chrono::steady_clock::time_point last_checkpoint;
+
+    // In low-latency mode, each chunk is written and flushed as soon as it
+    // is ready instead of in the order in which the chunks were read
+    bool low_latency{false};
+    // Time from reading each read to writing its records
+    LatencyHistogram latencies;
+
+    void enable_checkpoints(const std::string& path, std::chrono::duration<double> interval, Checkpoint checkpoint);
+    bool checkpoints_enabled() const { return !checkpoint_path.empty(); }
+    void enable_low_latency();
+    void set_shard(size_t shard_index, size_t n_shards);
     void output_records(std::string chunk, size_t chunk_index);
+    void output_records(
+        std::string chunk,
+        size_t chunk_index,
+        const AlignmentStatistics& statistics,
+        std::vector<double> abundances,
+        const std::vector<ChunkReader::time_point>& arrival_times = {}
+    );
+    void write_checkpoint();
 };
 
 
@@ -69,4 +203,6 @@ void perform_task(InputBuffer &input_buffer, OutputBuffer &output_buffer,
 
 bool same_name(const std::string& n1, const std::string& n2);
 
+void check_mates(const std::vector<klibpp::KSeq>& records1, const std::vector<klibpp::KSeq>& records2);
+
 #endif
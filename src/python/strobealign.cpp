@@ -153,10 +153,12 @@ NB_MODULE(strobealign_extension, m_) {
         .def_ro("query_end", &Nam::query_end)
         .def_ro("ref_start", &Nam::ref_start)
         .def_ro("ref_end", &Nam::ref_end)
-        .def_ro("score", &Nam::score)
-        .def_ro("n_hits", &Nam::n_matches)
+        .def_prop_ro("score", &Nam::score)
+        .def_prop_ro("n_hits", [](const Nam& nam) -> int { return nam.n_matches; })
         .def_ro("reference_index", &Nam::ref_id)
-        .def_rw("is_revcomp", &Nam::is_revcomp)
+        .def_prop_rw("is_revcomp",
+            [](const Nam& nam) -> bool { return nam.is_revcomp; },
+            [](Nam& nam, bool is_revcomp) { nam.is_revcomp = is_revcomp; })
         .def_prop_ro("ref_span", &Nam::ref_span)
         .def_prop_ro("query_span", &Nam::query_span)
         .def("__repr__", [](const Nam& nam) {
@@ -191,7 +193,8 @@ NB_MODULE(strobealign_extension, m_) {
     m.def("randstrobes_query", &randstrobes_query);
 
     m.def("find_hits", [](const std::vector<QueryRandstrobe>& query_randstrobes, const StrobemerIndex& index, bool use_mcs) -> std::vector<Hit> {
-        auto [total_hits, partial_hits, sorting_needed, hits] = find_hits(query_randstrobes, index, use_mcs);
+        auto lookups = lookup_randstrobes(query_randstrobes, index, use_mcs);
+        auto [total_hits, partial_hits, sorting_needed, hits] = find_hits(query_randstrobes, lookups, index, use_mcs);
         return hits;
     }, nb::arg("query_randstrobes"), nb::arg("index"), nb::arg("use_mcs"));
 
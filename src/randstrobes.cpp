@@ -4,45 +4,30 @@
 #include <algorithm>
 #include <cassert>
 #include <array>
+#include <limits>
 
 #include "hash.hpp"
 #include "randstrobes.hpp"
+#include "sequtils.hpp"
 
-// a, A -> 0
-// c, C -> 1
-// g, G -> 2
-// t, T, u, U -> 3
-static unsigned char seq_nt4_table[256] = {
-        0, 1, 2, 3,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
-        4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
-};
-
-static inline syncmer_hash_t syncmer_kmer_hash(uint64_t packed) {
+static inline syncmer_hash_t syncmer_kmer_hash(uint64_t packed, SyncmerHash hash) {
     // return robin_hash(yk);
     // return yk;
     // return hash64(yk, mask);
     // return sahlin_dna_hash(yk, mask);
+    if (hash == SyncmerHash::MultiplyXorshift) {
+        return multiply_xorshift(packed);
+    }
     return xxh64(packed);
 }
 
-static inline syncmer_hash_t syncmer_smer_hash(uint64_t packed) {
+static inline syncmer_hash_t syncmer_smer_hash(uint64_t packed, SyncmerHash hash) {
     // return ys;
     // return robin_hash(ys);
     // return hash64(ys, mask);
+    if (hash == SyncmerHash::MultiplyXorshift) {
+        return multiply_xorshift(packed);
+    }
     return xxh64(packed);
 }
 
@@ -70,7 +55,12 @@ std::ostream& operator<<(std::ostream& os, const Syncmer& syncmer) {
 Syncmer SyncmerIterator::next() {
     for ( ; i < seq.length(); ++i) {
 //    for (size_t i = 0; i < seq.length(); i++) {
-        int c = seq_nt4_table[(uint8_t) seq[i]];
+        if (i >= codes_end) {
+            codes_start = i;
+            codes_end = std::min(i + codes.size(), seq.length());
+            encode_nt4(seq.data() + i, codes_end - i, codes.data());
+        }
+        int c = codes[i - codes_start];
         if (c < 4) { // not an "N" base
             xk[0] = (xk[0] << 2 | c) & kmask;                  // forward strand
             xk[1] = xk[1] >> 2 | (uint64_t)(3 - c) << kshift;  // reverse strand
@@ -81,7 +71,7 @@ Syncmer SyncmerIterator::next() {
             }
             // we find an s-mer
             uint64_t ys = std::min(xs[0], xs[1]);
-            uint64_t hash_s = syncmer_smer_hash(ys);
+            uint64_t hash_s = syncmer_smer_hash(ys, parameters.hash);
             qs.push_back(hash_s);
             // not enough hashes in the queue, yet
             if (qs.size() < static_cast<size_t>(parameters.k - parameters.s + 1)) {
@@ -113,7 +103,7 @@ Syncmer SyncmerIterator::next() {
             }
             if (qs[parameters.t_syncmer - 1] == qs_min_val) { // occurs at t:th position in k-mer
                 uint64_t yk = std::min(xk[0], xk[1]);
-                auto syncmer = Syncmer{syncmer_kmer_hash(yk), i - parameters.k + 1};
+                auto syncmer = Syncmer{syncmer_kmer_hash(yk, parameters.hash), i - parameters.k + 1};
                 i++;
                 return syncmer;
             }
@@ -222,7 +212,20 @@ Randstrobe RandstrobeGenerator::next() {
 }
 
 /*
- * Generate randstrobes for a query sequence and its reverse complement.
+ * Generate the randstrobes of a query sequence and of its reverse complement.
+ *
+ * Canonical syncmers are invariant under reverse complementing, so the
+ * syncmers of the forward sequence are computed once and both strands are
+ * seeded in a single pass over them. For the forward strand, syncmer i is
+ * paired with a syncmer to its right; for the reverse complement, it is
+ * paired with one to its left, which is exactly what running a
+ * RandstrobeIterator over the reversed syncmer list would do.
+ *
+ * Randstrobes themselves cannot be re-used for the reverse complement:
+ * If in the forward direction, syncmer[i] and syncmer[j] were paired up, it
+ * is not necessarily the case that syncmer[j] is going to be paired with
+ * syncmer[i] in the reverse direction because i is fixed in the forward
+ * direction and j is fixed in the reverse direction.
  */
 std::array<std::vector<QueryRandstrobe>, 2> randstrobes_query(const std::string_view seq, const IndexParameters& parameters) {
     std::array<std::vector<QueryRandstrobe>, 2> randstrobes;
@@ -230,44 +233,134 @@ std::array<std::vector<QueryRandstrobe>, 2> randstrobes_query(const std::string_
         return randstrobes;
     }
 
-    // Generate syncmers for the forward sequence
-    auto syncmers = canonical_syncmers(seq, parameters.syncmer);
-    if (syncmers.empty()) {
+    std::vector<Syncmer> syncmers;
+    syncmers.reserve(seq.length() / (parameters.syncmer.k - parameters.syncmer.s + 1) * 2 + 16);
+    SyncmerIterator syncmer_iterator{seq, parameters.syncmer};
+    Syncmer syncmer;
+    while (!(syncmer = syncmer_iterator.next()).is_end()) {
+        syncmers.push_back(syncmer);
+    }
+
+    const size_t n = syncmers.size();
+    const size_t w_min = parameters.randstrobe.w_min;
+    const size_t w_max = parameters.randstrobe.w_max;
+    if (n <= w_min) {
         return randstrobes;
     }
+    const auto& rs_parameters = parameters.randstrobe;
+    const size_t max_dist = rs_parameters.max_dist;
+    const size_t k = parameters.syncmer.k;
+    const size_t length = seq.length();
+
+    // Each syncmer with at least w_min syncmers to its right (left) starts
+    // exactly one forward (reverse complement) randstrobe
+    randstrobes[0].resize(n - w_min);
+    randstrobes[1].resize(n - w_min);
 
-    // Generate randstrobes for the forward sequence
-    RandstrobeIterator randstrobe_fwd_iter{syncmers, parameters.randstrobe};
-    while (randstrobe_fwd_iter.has_next()) {
-        auto randstrobe = randstrobe_fwd_iter.next();
-        randstrobes[0].push_back(
-            QueryRandstrobe {
-                randstrobe.hash, randstrobe.hash_revcomp, randstrobe.strobe1_pos, randstrobe.strobe2_pos + parameters.syncmer.k
+    for (size_t i = 0; i < n; i++) {
+        const Syncmer& strobe1 = syncmers[i];
+
+        if (i + w_min < n) {
+            const size_t w_end = std::min(i + w_max, n - 1);
+            uint64_t min_val = std::numeric_limits<uint64_t>::max();
+            const Syncmer* strobe2 = &strobe1;
+            for (size_t j = i + w_min; j <= w_end && syncmers[j].position <= strobe1.position + max_dist; j++) {
+                uint64_t res = std::bitset<64>((strobe1.hash ^ syncmers[j].hash) & rs_parameters.q).count();
+                if (res < min_val) {
+                    min_val = res;
+                    strobe2 = &syncmers[j];
+                }
             }
-        );
+            randstrobes[0][i] = QueryRandstrobe{
+                randstrobe_hash(strobe1.hash, strobe2->hash, rs_parameters.main_hash_mask),
+                randstrobe_hash(strobe2->hash, strobe1.hash, rs_parameters.main_hash_mask),
+                static_cast<unsigned int>(strobe1.position),
+                static_cast<unsigned int>(strobe2->position + k)
+            };
+        }
+
+        if (i >= w_min) {
+            // Same window as above, but mirrored
+            const size_t w_end = i >= w_max ? i - w_max : 0;
+            uint64_t min_val = std::numeric_limits<uint64_t>::max();
+            const Syncmer* strobe2 = &strobe1;
+            for (size_t j = i - w_min; strobe1.position - syncmers[j].position <= max_dist; j--) {
+                uint64_t res = std::bitset<64>((strobe1.hash ^ syncmers[j].hash) & rs_parameters.q).count();
+                if (res < min_val) {
+                    min_val = res;
+                    strobe2 = &syncmers[j];
+                }
+                if (j == w_end) {
+                    break;
+                }
+            }
+            randstrobes[1][n - 1 - i] = QueryRandstrobe{
+                randstrobe_hash(strobe1.hash, strobe2->hash, rs_parameters.main_hash_mask),
+                randstrobe_hash(strobe2->hash, strobe1.hash, rs_parameters.main_hash_mask),
+                static_cast<unsigned int>(length - strobe1.position - k),
+                static_cast<unsigned int>(length - strobe2->position)
+            };
+        }
     }
+    return randstrobes;
+}
 
-    // For the reverse complement, we can re-use the syncmers of the forward
-    // sequence because canonical syncmers are invariant under reverse
-    // complementing. Only the coordinates need to be adjusted.
-    std::reverse(syncmers.begin(), syncmers.end());
-    for (size_t i = 0; i < syncmers.size(); i++) {
-        syncmers[i].position = seq.length() - syncmers[i].position - parameters.syncmer.k;
+/*
+ * Remove query randstrobes in which one of the two strobes overlaps a base
+ * with a (Phred) base quality below min_quality. Such randstrobes are
+ * unlikely to be found in the index, so looking them up is mostly wasted
+ * time.
+ *
+ * qual is the quality string of the forward read. If all randstrobes would
+ * be removed, none are. Return the number of removed randstrobes.
+ */
+size_t remove_low_quality_randstrobes(
+    std::array<std::vector<QueryRandstrobe>, 2>& randstrobes, const std::string_view qual, int min_quality, size_t k
+) {
+    if (min_quality <= 0 || qual.empty()) {
+        return 0;
+    }
+    // low[i] is the number of low-quality bases in qual[0..i)
+    const size_t length = qual.length();
+    std::vector<unsigned int> low(length + 1);
+    bool any_low = false;
+    for (size_t i = 0; i < length; ++i) {
+        bool is_low = qual[i] - 33 < min_quality;
+        any_low |= is_low;
+        low[i + 1] = low[i] + is_low;
     }
+    if (!any_low) {
+        return 0;
+    }
+    auto has_low = [&](size_t start, size_t end) {
+        return low[end] != low[start];
+    };
+    auto is_low_quality = [&](const QueryRandstrobe& q, bool is_revcomp) {
+        size_t strobe1_start = q.start;
+        size_t strobe2_end = q.end;
+        if (is_revcomp) {
+            // Translate to forward read coordinates
+            strobe1_start = length - q.end;
+            strobe2_end = length - q.start;
+        }
+        return has_low(strobe1_start, strobe1_start + k) || has_low(strobe2_end - k, strobe2_end);
+    };
 
-    // Randstrobes cannot be re-used for the reverse complement:
-    // If in the forward direction, syncmer[i] and syncmer[j] were paired up, it
-    // is not necessarily the case that syncmer[j] is going to be paired with
-    // syncmer[i] in the reverse direction because i is fixed in the forward
-    // direction and j is fixed in the reverse direction.
-    RandstrobeIterator randstrobe_rc_iter{syncmers, parameters.randstrobe};
-    while (randstrobe_rc_iter.has_next()) {
-        auto randstrobe = randstrobe_rc_iter.next();
-        randstrobes[1].push_back(
-            QueryRandstrobe {
-                randstrobe.hash, randstrobe.hash_revcomp, randstrobe.strobe1_pos, randstrobe.strobe2_pos + parameters.syncmer.k
-            }
-        );
+    size_t n_remaining = 0;
+    for (int is_revcomp : {0, 1}) {
+        for (auto& q : randstrobes[is_revcomp]) {
+            n_remaining += !is_low_quality(q, is_revcomp);
+        }
     }
-    return randstrobes;
+    if (n_remaining == 0) {
+        return 0;
+    }
+    size_t n_removed = 0;
+    for (int is_revcomp : {0, 1}) {
+        auto& v = randstrobes[is_revcomp];
+        auto new_end = std::remove_if(v.begin(), v.end(), [&](const QueryRandstrobe& q) { return is_low_quality(q, is_revcomp); });
+        n_removed += v.end() - new_end;
+        v.erase(new_end, v.end());
+    }
+    return n_removed;
 }
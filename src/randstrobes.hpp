@@ -2,6 +2,7 @@
 #define STROBEALIGN_RANDSTROBES_HPP
 
 #include <vector>
+#include <array>
 #include <string>
 #include <tuple>
 #include <deque>
@@ -69,12 +70,20 @@ struct QueryRandstrobe {
     randstrobe_hash_t hash_revcomp;
     unsigned int start;
     unsigned int end;
+
+    bool operator==(const QueryRandstrobe& other) const {
+        return hash == other.hash && hash_revcomp == other.hash_revcomp && start == other.start && end == other.end;
+    }
 };
 
 std::ostream& operator<<(std::ostream& os, const QueryRandstrobe& randstrobe);
 
 std::array<std::vector<QueryRandstrobe>, 2> randstrobes_query(const std::string_view seq, const IndexParameters& parameters);
 
+size_t remove_low_quality_randstrobes(
+    std::array<std::vector<QueryRandstrobe>, 2>& randstrobes, const std::string_view qual, int min_quality, size_t k
+);
+
 struct Randstrobe {
     randstrobe_hash_t hash;
     randstrobe_hash_t hash_revcomp;
@@ -158,6 +167,11 @@ private:
     uint64_t xk[2] = {0, 0};
     uint64_t xs[2] = {0, 0};
     size_t i = 0;
+
+    // Nucleotides (see encode_nt4) of seq[codes_start:codes_end]
+    std::array<uint8_t, 64> codes;
+    size_t codes_start = 0;
+    size_t codes_end = 0;
 };
 
 /*
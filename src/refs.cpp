@@ -5,20 +5,9 @@
 #include <regex>
 #include <string_view>
 #include "refs.hpp"
+#include "sequtils.hpp"
 #include "zstr.hpp"
 
-
-/* Convert string to uppercase in-place */
-void to_uppercase(std::string& s) {
-        std::transform(s.begin(), s.end(), s.begin(),
-        [](unsigned char c) {
-            return c & ~32;
-        }
-    );
-}
-
-namespace {
-
 void check_no_duplicates(const std::vector<std::string>& names) {
     std::vector<std::string_view> names_view{names.begin(), names.end()};
     std::sort(names_view.begin(), names_view.end());
@@ -31,6 +20,8 @@ void check_no_duplicates(const std::vector<std::string>& names) {
     }
 }
 
+namespace {
+
 // Check whether a name is fine to use in SAM output.
 // The SAM specification is much stricter than this and forbids these
 // characters: "\'()*,<=>[\\]`{}
@@ -50,10 +41,7 @@ bool is_valid_name(const std::string& name) {
 }
 
 template <typename T>
-References references_from_stream(T& stream) {
-    std::vector<std::string> sequences;
-    std::vector<std::string> names;
-
+void read_fasta_stream(T& stream, const FastaRecordCallback& on_record) {
     if (!stream.good()) {
         throw InvalidFasta("Cannot read from FASTA file");
     }
@@ -75,9 +63,9 @@ References references_from_stream(T& stream) {
         if (eof || (!line.empty() && line[0] == '>')) {
             if (seq.length() > 0) {
                 to_uppercase(seq);
-                sequences.push_back(std::move(seq));
+                on_record(std::move(name), std::move(seq));
                 seq.clear();
-                names.push_back(std::move(name));
+                name.clear();
             }
             if (!eof) {
                 // Cut at the first whitespace
@@ -96,24 +84,37 @@ References references_from_stream(T& stream) {
             seq += line;
         }
     } while (!eof);
-
-    check_no_duplicates(names);
-    return References(std::move(sequences), std::move(names));
 }
 
 }
 
-/* Read compressed or uncompressed reference */
-References References::from_fasta(const std::string& filename) {
+/*
+ * Read a compressed or uncompressed FASTA file and call on_record with the
+ * name and the uppercased sequence of each record as soon as it has been
+ * parsed. Records with an empty sequence are skipped.
+ */
+void read_fasta(const std::string& filename, const FastaRecordCallback& on_record) {
     if (filename.length() > 3 && filename.substr(filename.length() - 3, 3) == ".gz") {
         zstr::ifstream ifs(filename);
-        return references_from_stream(ifs);
+        read_fasta_stream(ifs, on_record);
     } else {
         std::ifstream ifs(filename);
-        return references_from_stream(ifs);
+        read_fasta_stream(ifs, on_record);
     }
 }
 
+/* Read compressed or uncompressed reference */
+References References::from_fasta(const std::string& filename) {
+    std::vector<std::string> sequences;
+    std::vector<std::string> names;
+    read_fasta(filename, [&](std::string&& name, std::string&& sequence) {
+        names.push_back(std::move(name));
+        sequences.push_back(std::move(sequence));
+    });
+    check_no_duplicates(names);
+    return References(std::move(sequences), std::move(names));
+}
+
 void References::add(std::string&& name, std::string&& sequence) {
     names.push_back(name);
     sequences.push_back(sequence);
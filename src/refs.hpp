@@ -6,6 +6,7 @@
 #include <stdexcept>
 #include <numeric>
 #include <vector>
+#include <functional>
 #include "exceptions.hpp"
 
 class References {
@@ -45,9 +46,11 @@ public:
     ref_names names;
     ref_lengths lengths;
 private:
-    size_t _total_length;
+    size_t _total_length{0};
 };
 
-void to_uppercase(std::string& s);
+using FastaRecordCallback = std::function<void(std::string&& name, std::string&& sequence)>;
+void read_fasta(const std::string& filename, const FastaRecordCallback& on_record);
+void check_no_duplicates(const std::vector<std::string>& names);
 
 #endif
@@ -2,56 +2,37 @@
 #define STROBEALIGN_REVCOMP_HPP
 
 #include <string>
-#include <algorithm>
+#include "sequtils.hpp"
 
-// a, A -> T
-// c, C -> G
-// g, G -> C
-// t, T, u, U -> A
-static unsigned char revcomp_table[256] = {
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'T', 'N', 'G',  'N', 'N', 'N', 'C',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'A', 'A', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'T', 'N', 'G',  'N', 'N', 'N', 'C',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'A', 'A', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
-    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N'
-};
-
-static inline std::string reverse_complement(const std::string &sequence) {
-    std::string result;
-    result.reserve(sequence.size());
-    for (size_t i = 0; i < sequence.length(); ++i) {
-        auto ch = sequence[sequence.length() - i - 1];
-        result.push_back(revcomp_table[static_cast<int>(ch)]);
-    }
-    return result;
-}
-
-/* A (nucleotide) sequence and its reverse complement. */
+/*
+ * A (nucleotide) sequence and its reverse complement.
+ *
+ * The reverse complement is only computed when it is first needed.
+ */
 class Read {
 public:
     const std::string& seq;
-    const std::string rc;
 
     Read(const std::string& s)
       : seq(s)
-      , rc(reverse_complement(s))
     {
     }
 
+    const std::string& rc() const {
+        if (!m_rc_computed) {
+            m_rc = reverse_complement(seq);
+            m_rc_computed = true;
+        }
+        return m_rc;
+    }
+
     std::string::size_type size() const {
         return seq.size();
     }
+
+private:
+    mutable std::string m_rc;
+    mutable bool m_rc_computed{false};
 };
 
 #endif
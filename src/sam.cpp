@@ -130,7 +130,7 @@ void Sam::add_unmapped_pair(const KSeq& r1, const KSeq& r2) {
 void Sam::add(
     const Alignment& alignment,
     const KSeq& record,
-    const std::string& sequence_rc,
+    const Read& read,
     uint8_t mapq,
     bool is_primary,
     const Details& details
@@ -145,7 +145,7 @@ void Sam::add(
         flags |= SECONDARY;
         mapq = 0;
     }
-    add_record(record.name, record.comment, flags, references.names[alignment.ref_id], alignment.ref_start, mapq, alignment.cigar, "*", -1, 0, record.seq, sequence_rc, record.qual, alignment.edit_distance, alignment.score, details);
+    add_record(record.name, record.comment, flags, references.names[alignment.ref_id], alignment.ref_start, mapq, alignment.cigar, "*", -1, 0, read, record.qual, alignment.edit_distance, alignment.score, details);
 }
 
 // Add one individual record
@@ -160,8 +160,7 @@ void Sam::add_record(
     const std::string& mate_reference_name,
     uint32_t mate_pos,
     int32_t template_len,
-    const std::string& query_sequence,
-    const std::string& query_sequence_rc,
+    const Read& read,
     const std::string& qual,
     int ed,
     int aln_score,
@@ -190,9 +189,9 @@ void Sam::add_record(
     if (flags & SECONDARY) {
         append_seq("");
     } else if (flags & REVERSE) {
-        append_seq(query_sequence_rc);
+        append_seq(read.rc());
     } else {
-        append_seq(query_sequence);
+        append_seq(read.seq);
     }
 
     if (!(flags & UNMAP)) {
@@ -234,8 +233,8 @@ void Sam::add_pair(
     const Alignment &alignment2,
     const KSeq& record1,
     const KSeq& record2,
-    const std::string &read1_rc,
-    const std::string &read2_rc,
+    const Read& read1,
+    const Read& read2,
     uint8_t mapq1,
     uint8_t mapq2,
     bool is_proper,
@@ -320,12 +319,12 @@ void Sam::add_pair(
     if (alignment1.is_unaligned) {
         add_unmapped_mate(record1, f1, reference_name2, pos2);
     } else {
-        add_record(record1.name, record1.comment, f1, reference_name1, alignment1.ref_start, mapq1, alignment1.cigar, mate_reference_name2, pos2, template_len1, record1.seq, read1_rc, record1.qual, edit_distance1, alignment1.score, details[0]);
+        add_record(record1.name, record1.comment, f1, reference_name1, alignment1.ref_start, mapq1, alignment1.cigar, mate_reference_name2, pos2, template_len1, read1, record1.qual, edit_distance1, alignment1.score, details[0]);
     }
     if (alignment2.is_unaligned) {
         add_unmapped_mate(record2, f2, reference_name1, pos1);
     } else {
-        add_record(record2.name, record2.comment, f2, reference_name2, alignment2.ref_start, mapq2, alignment2.cigar, mate_reference_name1, pos1, -template_len1, record2.seq, read2_rc, record2.qual, edit_distance2, alignment2.score, details[1]);
+        add_record(record2.name, record2.comment, f2, reference_name2, alignment2.ref_start, mapq2, alignment2.cigar, mate_reference_name1, pos1, -template_len1, read2, record2.qual, edit_distance2, alignment2.score, details[1]);
     }
 }
 
@@ -0,0 +1,201 @@
+#include "sequtils.hpp"
+
+#include "simd.hpp"
+#ifdef STROBEALIGN_SIMD_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+
+unsigned char revcomp_table[256] = {
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'T', 'N', 'G',  'N', 'N', 'N', 'C',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'A', 'A', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'T', 'N', 'G',  'N', 'N', 'N', 'C',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'A', 'A', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',
+    'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N',  'N', 'N', 'N', 'N'
+};
+
+unsigned char seq_nt4_table[256] = {
+    0, 1, 2, 3,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 0, 4, 1,  4, 4, 4, 2,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  3, 3, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,
+    4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4,  4, 4, 4, 4
+};
+
+void to_uppercase_impl(char* s, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        s[i] &= ~32;
+    }
+}
+
+void reverse_complement_impl(const char* seq, size_t length, char* out) {
+    for (size_t i = 0; i < length; ++i) {
+        out[i] = revcomp_table[static_cast<uint8_t>(seq[length - i - 1])];
+    }
+}
+
+void encode_nt4_impl(const char* seq, size_t length, uint8_t* codes) {
+    for (size_t i = 0; i < length; ++i) {
+        codes[i] = seq_nt4_table[static_cast<uint8_t>(seq[i])];
+    }
+}
+
+#ifdef STROBEALIGN_SIMD_DISPATCH
+
+/*
+ * All characters that the tables above do not map to the default value
+ * have 4 or 5 in the upper nibble once bit 5 (lowercase) is cleared. They
+ * are therefore translated with two 16-entry pshufb lookups indexed by the
+ * lower nibble.
+ */
+#define NT_TABLE(x, a, c, g) _mm_setr_epi8(x, a, x, c,  x, x, x, g,  x, x, x, x,  x, x, x, x)
+#define NT_TABLE_TU(x, t) _mm_setr_epi8(x, x, x, x,  t, t, x, x,  x, x, x, x,  x, x, x, x)
+
+STROBEALIGN_TARGET_SSE41 inline __m128i translate_sse41(__m128i v, __m128i table4, __m128i table5, char other) {
+    __m128i upper = _mm_and_si128(v, _mm_set1_epi8(~32));
+    __m128i low = _mm_and_si128(upper, _mm_set1_epi8(0x0f));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(upper, 4), _mm_set1_epi8(0x0f));
+    __m128i result = _mm_blendv_epi8(_mm_set1_epi8(other), _mm_shuffle_epi8(table4, low), _mm_cmpeq_epi8(high, _mm_set1_epi8(4)));
+    return _mm_blendv_epi8(result, _mm_shuffle_epi8(table5, low), _mm_cmpeq_epi8(high, _mm_set1_epi8(5)));
+}
+
+STROBEALIGN_TARGET_AVX2 inline __m256i translate_avx2(__m256i v, __m128i table4, __m128i table5, char other) {
+    __m256i upper = _mm256_and_si256(v, _mm256_set1_epi8(~32));
+    __m256i low = _mm256_and_si256(upper, _mm256_set1_epi8(0x0f));
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(upper, 4), _mm256_set1_epi8(0x0f));
+    __m256i result = _mm256_blendv_epi8(_mm256_set1_epi8(other), _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table4), low), _mm256_cmpeq_epi8(high, _mm256_set1_epi8(4)));
+    return _mm256_blendv_epi8(result, _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(table5), low), _mm256_cmpeq_epi8(high, _mm256_set1_epi8(5)));
+}
+
+STROBEALIGN_TARGET_SSE41 void to_uppercase_sse41(char* s, size_t length) {
+    size_t i = 0;
+    for ( ; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(s + i), _mm_and_si128(v, _mm_set1_epi8(~32)));
+    }
+    to_uppercase_impl(s + i, length - i);
+}
+
+STROBEALIGN_TARGET_AVX2 void to_uppercase_avx2(char* s, size_t length) {
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s + i), _mm256_and_si256(v, _mm256_set1_epi8(~32)));
+    }
+    to_uppercase_sse41(s + i, length - i);
+}
+
+STROBEALIGN_TARGET_SSE41 void reverse_complement_sse41(const char* seq, size_t length, char* out) {
+    const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    for ( ; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seq + length - i - 16));
+        v = translate_sse41(_mm_shuffle_epi8(v, reverse), NT_TABLE('N', 'T', 'G', 'C'), NT_TABLE_TU('N', 'A'), 'N');
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+    }
+    reverse_complement_impl(seq, length - i, out + i);
+}
+
+STROBEALIGN_TARGET_AVX2 void reverse_complement_avx2(const char* seq, size_t length, char* out) {
+    const __m256i reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+    );
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seq + length - i - 32));
+        // Reverse within the 128-bit lanes, then swap the lanes
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), 0x4e);
+        v = translate_avx2(v, NT_TABLE('N', 'T', 'G', 'C'), NT_TABLE_TU('N', 'A'), 'N');
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+    }
+    reverse_complement_sse41(seq, length - i, out + i);
+}
+
+STROBEALIGN_TARGET_SSE41 void encode_nt4_sse41(const char* seq, size_t length, uint8_t* codes) {
+    size_t i = 0;
+    for ( ; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(seq + i));
+        __m128i c = translate_sse41(v, NT_TABLE(4, 0, 1, 2), NT_TABLE_TU(4, 3), 4);
+        // Bytes 0 to 3 encode themselves
+        c = _mm_blendv_epi8(c, v, _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(3)), v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(codes + i), c);
+    }
+    encode_nt4_impl(seq + i, length - i, codes + i);
+}
+
+STROBEALIGN_TARGET_AVX2 void encode_nt4_avx2(const char* seq, size_t length, uint8_t* codes) {
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(seq + i));
+        __m256i c = translate_avx2(v, NT_TABLE(4, 0, 1, 2), NT_TABLE_TU(4, 3), 4);
+        c = _mm256_blendv_epi8(c, v, _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(3)), v));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + i), c);
+    }
+    encode_nt4_sse41(seq + i, length - i, codes + i);
+}
+
+// AVX-512 is not used because reads are too short to benefit from it
+STROBEALIGN_TARGET_AVX2 void to_uppercase_avx512(char* s, size_t length) {
+    to_uppercase_avx2(s, length);
+}
+
+STROBEALIGN_TARGET_AVX2 void reverse_complement_avx512(const char* seq, size_t length, char* out) {
+    reverse_complement_avx2(seq, length, out);
+}
+
+STROBEALIGN_TARGET_AVX2 void encode_nt4_avx512(const char* seq, size_t length, uint8_t* codes) {
+    encode_nt4_avx2(seq, length, codes);
+}
+
+#undef NT_TABLE
+#undef NT_TABLE_TU
+
+#endif
+
+}  // namespace
+
+void to_uppercase(std::string& s) {
+    STROBEALIGN_SIMD_DISPATCH_RETURN(simd_level(), to_uppercase, (s.data(), s.size()));
+}
+
+namespace {
+
+void reverse_complement_to(const char* seq, size_t length, char* out) {
+    STROBEALIGN_SIMD_DISPATCH_RETURN(simd_level(), reverse_complement, (seq, length, out));
+}
+
+}  // namespace
+
+std::string reverse_complement(const std::string& sequence) {
+    std::string result(sequence.size(), '\0');
+    reverse_complement_to(sequence.data(), sequence.size(), result.data());
+    return result;
+}
+
+void encode_nt4(const char* seq, size_t length, uint8_t* codes) {
+    STROBEALIGN_SIMD_DISPATCH_RETURN(simd_level(), encode_nt4, (seq, length, codes));
+}
@@ -0,0 +1,34 @@
+#ifndef STROBEALIGN_SEQUTILS_HPP
+#define STROBEALIGN_SEQUTILS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Functions for nucleotide sequences
+ *
+ * On x86-64, these use SSE4.1 or AVX2 (pshufb table lookups) if the CPU
+ * supports it (see simd.hpp). The scalar versions give the same results.
+ */
+
+// Convert to uppercase in-place. This clears bit 5 of every character,
+// which is sufficient for nucleotide sequences.
+void to_uppercase(std::string& s);
+
+// a, A -> T
+// c, C -> G
+// g, G -> C
+// t, T, u, U -> A
+// anything else -> N
+std::string reverse_complement(const std::string& sequence);
+
+// Encode the nucleotides of seq as
+// a, A -> 0
+// c, C -> 1
+// g, G -> 2
+// t, T, u, U -> 3
+// anything else -> 4 (except that the bytes 0 to 3 encode themselves)
+void encode_nt4(const char* seq, size_t length, uint8_t* codes);
+
+#endif
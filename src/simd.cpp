@@ -0,0 +1,68 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include "exceptions.hpp"
+#include "ssw/ssw.h"
+
+namespace {
+
+// Make the Smith-Waterman kernels in ext/ssw use the same instruction set
+SimdLevel activate(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::AVX512: ssw_set_vector_width(512); break;
+        case SimdLevel::AVX2: ssw_set_vector_width(256); break;
+        default: ssw_set_vector_width(128); break;
+    }
+    return level;
+}
+
+SimdLevel active_level = activate(detected_simd_level());
+
+}  // namespace
+
+SimdLevel detected_simd_level() {
+#ifdef STROBEALIGN_SIMD_DISPATCH
+    // These also check that the operating system saves the vector registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("popcnt")) {
+        return SimdLevel::SSE41;
+    }
+#endif
+    return SimdLevel::Baseline;
+}
+
+SimdLevel simd_level() {
+    return active_level;
+}
+
+SimdLevel set_simd_level(SimdLevel level) {
+    active_level = activate(std::min(level, detected_simd_level()));
+    return active_level;
+}
+
+std::string to_string(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Baseline: return "baseline";
+        case SimdLevel::SSE41: return "sse4.1";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+    }
+    return "";
+}
+
+SimdLevel simd_level_from_string(const std::string& name) {
+    for (auto level : {SimdLevel::Baseline, SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        if (name == to_string(level)) {
+            return level;
+        }
+    }
+    throw BadParameter("SIMD level must be one of baseline, sse4.1, avx2 and avx512");
+}
@@ -0,0 +1,70 @@
+#ifndef STROBEALIGN_SIMD_HPP
+#define STROBEALIGN_SIMD_HPP
+
+#include <string>
+
+/*
+ * Runtime selection of SIMD instruction sets
+ *
+ * Hot kernels are compiled once for each instruction set level and the best
+ * variant the CPU supports is chosen when they are called. A binary built
+ * for baseline x86-64 therefore runs at full speed on newer CPUs.
+ */
+enum class SimdLevel {
+    Baseline,  // SSE2 on x86-64; the only level on other architectures
+    SSE41,
+    AVX2,
+    AVX512,
+};
+
+// Highest level supported by the CPU (and operating system)
+SimdLevel detected_simd_level();
+
+// Level that the kernels use
+SimdLevel simd_level();
+
+// Use at most the given level (not thread safe; call at startup). Return
+// the level that is actually used.
+SimdLevel set_simd_level(SimdLevel level);
+
+std::string to_string(SimdLevel level);
+
+// Throw BadParameter if the name is not one of those returned by to_string()
+SimdLevel simd_level_from_string(const std::string& name);
+
+#define STROBEALIGN_ALWAYS_INLINE inline __attribute__((always_inline))
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define STROBEALIGN_SIMD_DISPATCH 1
+#define STROBEALIGN_TARGET_SSE41 __attribute__((target("sse4.1,popcnt")))
+#define STROBEALIGN_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#define STROBEALIGN_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx2,bmi,bmi2,popcnt")))
+
+/*
+ * Define functions name_sse41, name_avx2 and name_avx512 that call
+ * name_impl, which must be declared STROBEALIGN_ALWAYS_INLINE so that it is
+ * compiled for each instruction set.
+ */
+#define STROBEALIGN_DEFINE_SIMD_VARIANTS(return_type, name, parameters, arguments) \
+    STROBEALIGN_TARGET_SSE41 return_type name##_sse41 parameters { return name##_impl arguments; } \
+    STROBEALIGN_TARGET_AVX2 return_type name##_avx2 parameters { return name##_impl arguments; } \
+    STROBEALIGN_TARGET_AVX512 return_type name##_avx512 parameters { return name##_impl arguments; }
+
+// Return the result of the variant of name for the given level
+#define STROBEALIGN_SIMD_DISPATCH_RETURN(level, name, arguments) \
+    switch (level) { \
+        case SimdLevel::AVX512: return name##_avx512 arguments; \
+        case SimdLevel::AVX2: return name##_avx2 arguments; \
+        case SimdLevel::SSE41: return name##_sse41 arguments; \
+        case SimdLevel::Baseline: break; \
+    } \
+    return name##_impl arguments
+
+#else
+#define STROBEALIGN_DEFINE_SIMD_VARIANTS(return_type, name, parameters, arguments)
+#define STROBEALIGN_SIMD_DISPATCH_RETURN(level, name, arguments) \
+    (void)(level); \
+    return name##_impl arguments
+#endif
+
+#endif
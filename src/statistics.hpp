@@ -32,6 +32,7 @@ struct AlignmentStatistics {
     std::chrono::duration<double> tot_time_rescue{0};
     std::chrono::duration<double> tot_sort_nams{0};
     std::chrono::duration<double> tot_extend{0};
+    std::chrono::duration<double> tot_exact_match{0};
 
     uint64_t n_reads{0};
     uint64_t n_randstrobes{0};
@@ -45,6 +46,10 @@ struct AlignmentStatistics {
     uint64_t tried_alignment{0};
     uint64_t inconsistent_nams{0};
     uint64_t nam_rescue{0};
+    uint64_t n_exact_matches{0}; // reads output by the exact-match fast path
+    uint64_t n_long_reads{0}; // reads aligned in segments
+    uint64_t n_low_quality_randstrobes{0}; // randstrobes not looked up because of low base quality
+    uint64_t n_merged_nams{0}; // NAMs merged into another one at the same locus before extension
 
     AlignmentStatistics operator+=(const AlignmentStatistics& other) {
         this->tot_read_file += other.tot_read_file;
@@ -53,6 +58,7 @@ struct AlignmentStatistics {
         this->tot_time_rescue += other.tot_time_rescue;
         this->tot_sort_nams += other.tot_sort_nams;
         this->tot_extend += other.tot_extend;
+        this->tot_exact_match += other.tot_exact_match;
         this->n_reads += other.n_reads;
         this->n_randstrobes += other.n_randstrobes;
         this->n_hits += other.n_hits;
@@ -65,6 +71,10 @@ struct AlignmentStatistics {
         this->tried_alignment += other.tried_alignment;
         this->inconsistent_nams += other.inconsistent_nams;
         this->nam_rescue += other.nam_rescue;
+        this->n_exact_matches += other.n_exact_matches;
+        this->n_long_reads += other.n_long_reads;
+        this->n_low_quality_randstrobes += other.n_low_quality_randstrobes;
+        this->n_merged_nams += other.n_merged_nams;
         return *this;
     }
 
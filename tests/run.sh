@@ -24,6 +24,9 @@ build/test-strobealign --no-intro
 # should fail when unknown command-line option used
 if strobealign -G > /dev/null 2> /dev/null; then false; fi
 
+# should fail when the read names of R1 and R2 do not match
+if strobealign tests/phix.fasta tests/phix.1.fastq tests/phix.exact.fastq > /dev/null 2> /dev/null; then false; fi
+
 # should succeed when only printing help
 strobealign -h > /dev/null
 
@@ -35,6 +38,23 @@ strobealign --no-PG --eqx --chunk-size 3 --rg-id 1 --rg SM:sample --rg LB:librar
 diff tests/phix.se.sam phix.se.sam
 rm phix.se.sam
 
+# Exact-match fast path must not change the output
+strobealign --no-PG --eqx tests/phix.fasta tests/phix.exact.fastq > without-fast-path.sam
+strobealign --no-PG --eqx --exact-fast-path tests/phix.fasta tests/phix.exact.fastq > with-fast-path.sam
+diff without-fast-path.sam with-fast-path.sam
+strobealign --no-PG --eqx --details tests/phix.fasta tests/phix.exact.fastq > without-fast-path.sam
+strobealign --no-PG --eqx --details --exact-fast-path tests/phix.fasta tests/phix.exact.fastq > with-fast-path.sam
+diff without-fast-path.sam with-fast-path.sam
+rm without-fast-path.sam with-fast-path.sam
+
+# Long reads are only mapped in long-read mode, with one record each
+test $(strobealign tests/phix.fasta tests/phix.long.fastq | samtools view -c -F 4) -lt 4
+test $(strobealign --long-reads tests/phix.fasta tests/phix.long.fastq | samtools view -c -F 4) -eq 4
+test $(strobealign --long-reads tests/phix.fasta tests/phix.long.fastq | samtools view -c) -eq 4
+
+# Skipping low-quality randstrobes should not lose any of the phiX reads
+test $(strobealign --min-seed-quality 20 tests/phix.fasta tests/phix.1.fastq | samtools view -c -F 4) -eq $(strobealign tests/phix.fasta tests/phix.1.fastq | samtools view -c -F 4)
+
 # Single-end SAM, M CIGAR operators
 strobealign --no-PG tests/phix.fasta tests/phix.1.fastq > phix.se.m.sam
 if samtools view phix.se.m.sam | cut -f6 | grep -q '[X=]'; then false; fi
@@ -56,6 +76,16 @@ cat tests/phix.1.fastq | strobealign -x tests/phix.fasta - | tail -n 11 > phix.s
 diff tests/phix.se.paf phix.se.paf
 rm phix.se.paf
 
+# Single-end PAF (compressed stdin input)
+gzip -c tests/phix.1.fastq | strobealign -x tests/phix.fasta - | tail -n 11 > phix.se.paf
+diff tests/phix.se.paf phix.se.paf
+rm phix.se.paf
+
+# Paired-end PAF (input from pipes)
+strobealign -x tests/phix.fasta <(cat tests/phix.1.fastq) <(gzip -c tests/phix.2.fastq) | tail -n 11 > phix.pe.paf
+diff tests/phix.pe.paf phix.pe.paf
+rm phix.pe.paf
+
 # Paired-end PAF
 strobealign -x tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq | tail -n 11 > phix.pe.paf
 diff tests/phix.pe.paf phix.pe.paf
@@ -78,6 +108,22 @@ strobealign --no-PG -r 150 --use-index tests/phix.fasta tests/phix.1.fastq > wit
 diff without-sti.sam with-sti.sam
 rm without-sti.sam with-sti.sam
 
+# Index with hash table layout
+strobealign --no-PG -r 150 --index-layout hashtable tests/phix.fasta tests/phix.1.fastq > with-hashtable.sam
+strobealign -r 150 --index-layout hashtable -i tests/phix.fasta
+strobealign --no-PG -r 150 --use-index tests/phix.fasta tests/phix.1.fastq > with-hashtable-sti.sam
+diff with-hashtable.sam with-hashtable-sti.sam
+rm with-hashtable.sam with-hashtable-sti.sam
+
+# Index with the multiply-xorshift syncmer hash
+strobealign --no-PG -r 150 --hash mx tests/phix.fasta tests/phix.1.fastq > with-mx.sam
+strobealign -r 150 --hash mx -i tests/phix.fasta
+test -f tests/phix.fasta.r150.mx.sti
+strobealign --no-PG -r 150 --hash mx --use-index tests/phix.fasta tests/phix.1.fastq > with-mx-sti.sam
+diff with-mx.sam with-mx-sti.sam
+test $(samtools view -c -F 4 with-mx.sam) -eq $(samtools view -c -F 4 tests/phix.se.sam)
+rm with-mx.sam with-mx-sti.sam tests/phix.fasta.r150.mx.sti
+
 # Create index requires -r or reads file
 if strobealign --create-index tests/phix.fasta > /dev/null 2> /dev/null; then false; fi
 
@@ -116,9 +162,50 @@ strobealign --no-PG --eqx --rg-id 1 --rg SM:sample --rg LB:library tests/phix.fa
 diff tests/phix.se.sam multiblock.sam
 rm multiblock.fastq.gz multiblock.sam
 
-# Single-end PAF with multi-context seeds
-strobealign --mcs -x tests/phix.fasta tests/phix.1.fastq | tail -n 11 > phix.mcs.se.paf
-diff tests/phix.mcs.se.paf phix.mcs.se.paf
-rm phix.mcs.se.paf
+# Single-end PAF without per-seed multi-context seed fallback
+strobealign --no-mcs -x tests/phix.fasta tests/phix.1.fastq | tail -n 11 > phix.no-mcs.se.paf
+diff tests/phix.no-mcs.se.paf phix.no-mcs.se.paf
+rm phix.no-mcs.se.paf
+
+# Options --mcs and --no-mcs are mutually exclusive
+if strobealign --mcs --no-mcs tests/phix.fasta tests/phix.1.fastq > /dev/null 2> /dev/null; then false; fi
+
+# Concatenated output of all shards contains the same records as unsharded output
+strobealign --no-PG --chunk-size 3 tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > unsharded.sam
+for i in 1 2 3; do
+  strobealign --no-PG --chunk-size 3 --shard ${i}/3 tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > shard${i}.sam
+done
+diff <(grep '^@' unsharded.sam) <(cat shard1.sam shard2.sam shard3.sam | grep '^@')
+diff <(sort unsharded.sam) <(cat shard1.sam shard2.sam shard3.sam | sort)
+rm unsharded.sam shard1.sam shard2.sam shard3.sam
+
+# Invalid shard specification
+if strobealign --shard 4/3 tests/phix.fasta tests/phix.1.fastq > /dev/null 2> /dev/null; then false; fi
+
+# Output does not depend on the SIMD instruction set
+strobealign --no-PG tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > default-simd.sam
+strobealign --no-PG --simd baseline tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > baseline-simd.sam
+diff default-simd.sam baseline-simd.sam
+rm default-simd.sam baseline-simd.sam
+
+# Low-latency mode gives the same records as normal mode
+strobealign --no-PG -r 150 tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > normal.sam
+strobealign --no-PG -r 150 -t 3 --chunk-size 7 --max-batch-delay 5 tests/phix.fasta <(cat tests/phix.1.fastq) <(gzip -c tests/phix.2.fastq) > low-latency.sam
+diff <(sort normal.sam) <(sort low-latency.sam)
+grep -q "Latency from reading" testlog.txt
+rm normal.sam low-latency.sam
+if strobealign --max-batch-delay 5 --shard 1/2 tests/phix.fasta tests/phix.1.fastq > /dev/null 2> /dev/null; then false; fi
+
+# Resuming an interrupted run from a checkpoint gives the same output
+strobealign --no-PG -r 150 --chunk-size 3 -t 3 tests/phix.fasta tests/phix.1.fastq tests/phix.2.fastq > without-checkpoint.sam
+sed '81s/^@/@x/' tests/phix.2.fastq > checkpoint.2.fastq
+if strobealign --no-PG -r 150 --chunk-size 3 -t 3 --checkpoint checkpoint.bin -o with-checkpoint.sam tests/phix.fasta tests/phix.1.fastq checkpoint.2.fastq; then false; fi
+test -f checkpoint.bin
+cp tests/phix.2.fastq checkpoint.2.fastq
+if strobealign --no-PG -r 150 --chunk-size 3 -t 2 --checkpoint checkpoint.bin -o with-checkpoint.sam tests/phix.fasta tests/phix.1.fastq checkpoint.2.fastq; then false; fi
+strobealign --no-PG -r 150 --chunk-size 3 -t 3 --checkpoint checkpoint.bin -o with-checkpoint.sam tests/phix.fasta tests/phix.1.fastq checkpoint.2.fastq
+test ! -f checkpoint.bin
+diff without-checkpoint.sam with-checkpoint.sam
+rm without-checkpoint.sam with-checkpoint.sam checkpoint.2.fastq
 
 echo "Success"
@@ -1,5 +1,7 @@
+#include <random>
 #include "doctest.h"
 #include "aligner.hpp"
+#include "simd.hpp"
 
 TEST_CASE("hamming_align") {
     // empty sequences
@@ -165,3 +167,137 @@ TEST_CASE("ssw align no result") {
     auto info = aligner.align(query, ref);
     CHECK(!info.has_value());
 }
+
+TEST_CASE("banded_align") {
+    AlignmentParameters parameters{2, 8, 12, 1, 10};
+    auto diagonal = [](const std::string& query, int offset) {
+        std::vector<int> centers;
+        for (size_t i = 0; i <= query.length(); i++) {
+            centers.push_back(i + offset);
+        }
+        return centers;
+    };
+
+    SUBCASE("exact match") {
+        std::string query = "ACGTACGGTCAGTTGACCA";
+        std::string ref = "TTT" + query + "GGG";
+        auto info = banded_align(query, ref, diagonal(query, 3), 5, parameters);
+        CHECK(info.cigar.to_string() == "19=");
+        CHECK(info.edit_distance == 0);
+        CHECK(info.sw_score == 19 * 2 + 2 * 10);
+        CHECK(info.ref_start == 3);
+        CHECK(info.ref_end == 22);
+        CHECK(info.query_start == 0);
+        CHECK(info.query_end == 19);
+    }
+
+    SUBCASE("mismatch and deletion") {
+        std::string ref =   "ACGTACGGTCAGTTGACCATTGACCAGTAGCATTACG";
+        std::string query = "ACGTTCGGTCAGTTGACCATTGACCGTAGCATTACG";
+        auto info = banded_align(query, ref, diagonal(query, 0), 5, parameters);
+        CHECK(info.cigar.to_string() == "4=1X20=1D11=");
+        CHECK(info.edit_distance == 2);
+        CHECK(info.sw_score == 35 * 2 - 8 - 12 + 2 * 10);
+        CHECK(info.ref_start == 0);
+        CHECK(info.ref_end == ref.length());
+    }
+
+    SUBCASE("insertion") {
+        std::string ref =   "ACGTACGGTCAGTTGACCATTGACCAGTAGCATTACG";
+        std::string query = "ACGTACGGTCAGTTGACCATTTTGACCAGTAGCATTACG";
+        auto info = banded_align(query, ref, diagonal(query, 0), 5, parameters);
+        CHECK(info.cigar.to_string() == "19=2I18=");
+        CHECK(info.edit_distance == 2);
+        CHECK(info.sw_score == 37 * 2 - 12 - 1 + 2 * 10);
+    }
+
+    SUBCASE("soft clipping") {
+        std::string ref =   "ACGTACGGTCAGTTGACCATTGACCAGTAGCATTACG";
+        std::string query = "TTTTTTTTTTTTGTTGACCATTGACCAGTAGCATTACG";
+        auto info = banded_align(query, ref, diagonal(query, -1), 5, parameters);
+        CHECK(info.cigar.to_string() == "12S26=");
+        CHECK(info.query_start == 12);
+        CHECK(info.ref_start == 11);
+        CHECK(info.sw_score == 26 * 2 + 10);
+    }
+}
+
+TEST_CASE("hamming_distance is the same at all SIMD levels") {
+    std::minstd_rand engine;
+    std::vector<std::pair<std::string, std::string>> pairs;
+    for (size_t length : {0, 1, 15, 16, 17, 31, 64, 150, 257}) {
+        std::string s, t;
+        for (size_t i = 0; i < length; ++i) {
+            s += "ACGT"[engine() % 4];
+            t += engine() % 8 == 0 ? "ACGT"[engine() % 4] : s.back();
+        }
+        pairs.emplace_back(s, t);
+    }
+    auto original_level = simd_level();
+    set_simd_level(SimdLevel::Baseline);
+    std::vector<int> distances;
+    for (auto& [s, t] : pairs) {
+        distances.push_back(hamming_distance(s, t));
+    }
+    for (auto level : {SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        set_simd_level(level);
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            CHECK(hamming_distance(pairs[i].first, pairs[i].second) == distances[i]);
+        }
+    }
+    set_simd_level(original_level);
+}
+
+TEST_CASE("Aligner::align gives the same result at all SIMD levels") {
+    AlignmentParameters parameters{2, 8, 12, 1, 10};
+    Aligner aligner{parameters};
+    std::minstd_rand engine;
+    std::vector<std::pair<std::string, std::string>> pairs;
+    // The longer queries score above 255 and need the 16-bit kernel
+    for (size_t length : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 150, 250, 500, 1000}) {
+        std::string query;
+        for (size_t i = 0; i < length; ++i) {
+            query += "ACGT"[engine() % 4];
+        }
+        std::string ref;
+        for (size_t i = 0; i < 20; ++i) {
+            ref += "ACGT"[engine() % 4];
+        }
+        for (size_t i = 0; i < length; ++i) {
+            auto r = engine() % 50;
+            if (r == 0) {
+                ref += "ACGT"[engine() % 4];  // mismatch
+            } else if (r == 1) {
+                ref += query[i];  // insertion in the reference
+                ref += "ACGT"[engine() % 4];
+            } else if (r != 2) {  // r == 2 is a deletion from the reference
+                ref += query[i];
+            }
+        }
+        ref += "ACGTTGCA";
+        pairs.emplace_back(query, ref);
+    }
+    auto original_level = simd_level();
+    set_simd_level(SimdLevel::Baseline);
+    std::vector<std::optional<AlignmentInfo>> expected;
+    for (auto& [query, ref] : pairs) {
+        expected.push_back(aligner.align(query, ref));
+    }
+    for (auto level : {SimdLevel::AVX2, SimdLevel::AVX512}) {
+        set_simd_level(level);
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            auto info = aligner.align(pairs[i].first, pairs[i].second);
+            REQUIRE(info.has_value() == expected[i].has_value());
+            if (info.has_value()) {
+                CHECK(info->cigar.to_string() == expected[i]->cigar.to_string());
+                CHECK(info->sw_score == expected[i]->sw_score);
+                CHECK(info->edit_distance == expected[i]->edit_distance);
+                CHECK(info->ref_start == expected[i]->ref_start);
+                CHECK(info->ref_end == expected[i]->ref_end);
+                CHECK(info->query_start == expected[i]->query_start);
+                CHECK(info->query_end == expected[i]->query_end);
+            }
+        }
+    }
+    set_simd_level(original_level);
+}
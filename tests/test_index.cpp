@@ -0,0 +1,212 @@
+#include "doctest.h"
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <random>
+#include "index.hpp"
+#include "io.hpp"
+
+namespace {
+
+/*
+ * Serialize a bucket directory with the given start indices (using
+ * superblock bases) in the format that BucketDirectory::write() uses. This
+ * avoids having to build one from more than 2^32 randstrobes.
+ */
+void write_directory_with_bases(std::ostream& os, const std::vector<uint64_t>& start_indices) {
+    const int superblock_bits = BucketDirectory::SUPERBLOCK_BITS;
+    std::vector<uint64_t> bases;
+    for (size_t bucket = 0; bucket < start_indices.size(); bucket += size_t{1} << superblock_bits) {
+        bases.push_back(start_indices[bucket]);
+    }
+    std::vector<uint32_t> offsets;
+    for (size_t bucket = 0; bucket < start_indices.size(); ++bucket) {
+        offsets.push_back(start_indices[bucket] - bases[bucket >> superblock_bits]);
+    }
+    write_vector(os, bases);
+    write_vector(os, offsets);
+}
+
+}
+
+TEST_CASE("Hash table layout finds the same entries as the bucket layout") {
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto parameters = IndexParameters::from_read_length(100);
+    StrobemerIndex buckets_index(references, parameters, 8, IndexLayout::Buckets);
+    StrobemerIndex hashtable_index(references, parameters, -1, IndexLayout::HashTable);
+    buckets_index.populate(0.0002, 1);
+    hashtable_index.populate(0.0002, 1);
+    REQUIRE(buckets_index.size() == hashtable_index.size());
+
+    for (size_t position = 0; position < buckets_index.size(); ++position) {
+        auto hash = buckets_index.get_hash(position);
+        auto full = hashtable_index.find_full(hash);
+        auto partial = hashtable_index.find_partial(hash);
+        CHECK(full == buckets_index.find_full(hash));
+        CHECK(partial == buckets_index.find_partial(hash));
+        CHECK(hashtable_index.get_count_full(full) == buckets_index.get_count_full(full));
+        CHECK(hashtable_index.get_count_partial(partial) == buckets_index.get_count_partial(partial));
+
+        // Flip a bit in the auxiliary part: May or may not be found
+        auto other_hash = hash ^ 0x100;
+        CHECK(hashtable_index.find_full(other_hash) == buckets_index.find_full(other_hash));
+    }
+    CHECK(hashtable_index.find_full(hashtable_index.get_hash(0)) == 0);
+}
+
+TEST_CASE("BucketDirectory") {
+    std::minstd_rand engine;
+    std::vector<RefRandstrobe> randstrobes;
+    for (size_t i = 0; i < 100000; ++i) {
+        // Skewed so that some buckets are empty and others are large
+        randstrobe_hash_t hash = (randstrobe_hash_t{engine()} << 32 | engine()) >> (engine() % 3);
+        randstrobes.push_back(RefRandstrobe{hash, 0, 0, 0});
+    }
+    std::sort(randstrobes.begin(), randstrobes.end());
+    for (int bits : {8, 16, 18}) {
+        for (size_t n_threads : {1, 3}) {
+            BucketDirectory directory;
+            directory.build(bits, randstrobes, n_threads);
+            const size_t n_buckets = size_t{1} << bits;
+            REQUIRE(directory.size() == n_buckets + 1);
+            size_t position = 0;
+            size_t mismatches = 0;
+            for (size_t bucket = 0; bucket <= n_buckets; ++bucket) {
+                while (position < randstrobes.size() && (randstrobes[position].hash() >> (64 - bits)) < bucket) {
+                    ++position;
+                }
+                mismatches += directory[bucket] != position;
+            }
+            CHECK(mismatches == 0);
+            CHECK(directory[n_buckets] == randstrobes.size());
+        }
+    }
+}
+
+TEST_CASE("BucketDirectory with more than 2^32 randstrobes uses superblock bases") {
+    const size_t n_buckets = size_t{1} << 18;
+    std::vector<uint64_t> start_indices(n_buckets + 1);
+    for (size_t bucket = 0; bucket <= n_buckets; ++bucket) {
+        start_indices[bucket] = bucket * 40000;
+    }
+    REQUIRE(start_indices.back() > UINT32_MAX);
+    std::stringstream serialized;
+    write_directory_with_bases(serialized, start_indices);
+    BucketDirectory directory;
+    directory.read(serialized);
+    REQUIRE(directory.size() == n_buckets + 1);
+    size_t mismatches = 0;
+    for (size_t bucket = 0; bucket <= n_buckets; ++bucket) {
+        mismatches += directory[bucket] != start_indices[bucket];
+    }
+    CHECK(mismatches == 0);
+    CHECK(directory.memory_usage() > 4 * (n_buckets + 1));
+
+    std::stringstream stream;
+    directory.write(stream);
+    BucketDirectory read_directory;
+    read_directory.read(stream);
+    CHECK(read_directory[n_buckets] == start_indices.back());
+    CHECK(read_directory[12345] == start_indices[12345]);
+}
+
+TEST_CASE("find_full_and_partial agrees with find_full and find_partial") {
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto parameters = IndexParameters::from_read_length(100);
+    for (auto layout : {IndexLayout::Buckets, IndexLayout::HashTable}) {
+        StrobemerIndex index(references, parameters, 8, layout);
+        index.populate(0.0002, 1);
+        for (size_t position = 0; position < index.size(); ++position) {
+            auto hash = index.get_hash(position);
+            // Flipping bits in the auxiliary part changes the full hash only
+            for (auto key : {hash, hash ^ 0x100, hash ^ 0x800, hash ^ (randstrobe_hash_t{1} << 63)}) {
+                auto [full, partial] = index.find_full_and_partial(key);
+                CHECK(full == index.find_full(key));
+                CHECK(partial == index.find_partial(key));
+            }
+        }
+    }
+}
+
+TEST_CASE("Each syncmer occurrence appears at most once per main hash") {
+    // The main hash of a reference randstrobe is always that of its first
+    // strobe, so expanding a partial (main-hash) hit never yields the same
+    // syncmer occurrence twice, even for repetitive references
+    auto phix = References::from_fasta("tests/phix.fasta").sequences[0];
+    References references{{phix, phix + phix}, {"phix", "phix2"}};
+    auto parameters = IndexParameters::from_read_length(100);
+    StrobemerIndex index(references, parameters);
+    index.populate(0.0002, 1);
+    size_t position = 0;
+    size_t longest_run = 0;
+    while (position < index.size()) {
+        const auto main_hash = index.get_main_hash(position);
+        std::set<std::pair<int, unsigned int>> occurrences;
+        size_t run_length = 0;
+        for ( ; index.get_main_hash(position) == main_hash; ++position) {
+            occurrences.emplace(index.reference_index(position), index.get_strobe1_position(position));
+            run_length++;
+        }
+        CHECK(occurrences.size() == run_length);
+        longest_run = std::max(longest_run, run_length);
+    }
+    CHECK(longest_run >= 3);
+}
+
+TEST_CASE("populate gives the same index no matter the number of threads") {
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto parameters = IndexParameters::from_read_length(100);
+    StrobemerIndex index1(references, parameters, 8);
+    StrobemerIndex index4(references, parameters, 8);
+    index1.populate(0.0002, 1);
+    index4.populate(0.0002, 4);
+    REQUIRE(index1.size() == index4.size());
+    CHECK(index1.filter_cutoff == index4.filter_cutoff);
+    CHECK(index1.stats.distinct_strobemers == index4.stats.distinct_strobemers);
+    CHECK(index1.stats.tot_occur_once == index4.stats.tot_occur_once);
+    CHECK(index1.stats.tot_mid_ab == index4.stats.tot_mid_ab);
+    CHECK(index1.stats.tot_high_ab == index4.stats.tot_high_ab);
+    for (size_t position = 0; position < index1.size(); ++position) {
+        auto hash = index1.get_hash(position);
+        CHECK(index1.find_full(hash) == index4.find_full(hash));
+        CHECK(index1.find_partial(hash) == index4.find_partial(hash));
+    }
+}
+
+TEST_CASE("Generating randstrobes while reading the reference gives the same index") {
+    auto phix = References::from_fasta("tests/phix.fasta").sequences[0];
+    {
+        std::ofstream ofs("tmpref.fasta");
+        for (size_t i = 0; i < 5; ++i) {
+            ofs << ">ref" << i << "\n" << phix.substr(i * 1000) << "\n";
+        }
+    }
+    auto parameters = IndexParameters::from_read_length(100);
+    auto references = References::from_fasta("tmpref.fasta");
+    StrobemerIndex index(references, parameters, 8);
+    index.populate(0.0002, 2);
+
+    References pipelined_references;
+    auto ref_randstrobes = read_references_and_generate_randstrobes("tmpref.fasta", parameters, 3, pipelined_references);
+    std::remove("tmpref.fasta");
+    REQUIRE(pipelined_references.names == references.names);
+    REQUIRE(pipelined_references.sequences == references.sequences);
+    StrobemerIndex pipelined_index(pipelined_references, parameters, 8);
+    pipelined_index.populate_from(ref_randstrobes, 0.0002, 2);
+
+    REQUIRE(index.size() == pipelined_index.size());
+    CHECK(index.filter_cutoff == pipelined_index.filter_cutoff);
+    for (size_t position = 0; position < index.size(); ++position) {
+        CHECK(index.get_hash(position) == pipelined_index.get_hash(position));
+        CHECK(index.get_strobe1_position(position) == pipelined_index.get_strobe1_position(position));
+        CHECK(index.reference_index(position) == pipelined_index.reference_index(position));
+    }
+}
+
+TEST_CASE("read_references_and_generate_randstrobes parse error") {
+    References references;
+    REQUIRE_THROWS_AS(
+        read_references_and_generate_randstrobes("tests/phix.1.fastq", IndexParameters::from_read_length(100), 2, references),
+        InvalidFasta
+    );
+}
@@ -1,4 +1,5 @@
 #include "doctest.h"
+#include <sstream>
 #include "indexparameters.hpp"
 
 
@@ -41,3 +42,28 @@ TEST_CASE("test IndexParameters constructor") {
     CHECK(ip2.randstrobe == rp);
     CHECK(ip2.syncmer == sp);
 }
+
+TEST_CASE("IndexParameters write and read round trip") {
+    auto def = IndexParameters::DEFAULT;
+    for (auto hash : {SyncmerHash::XXH64, SyncmerHash::MultiplyXorshift}) {
+        IndexParameters ip = IndexParameters::from_read_length(150, def, def, def, def, def, def, def, hash);
+        CHECK(ip.syncmer.hash == hash);
+        std::stringstream ss;
+        ip.write(ss);
+        CHECK(IndexParameters::read(ss) == ip);
+    }
+}
+
+TEST_CASE("Syncmer hash function") {
+    auto def = IndexParameters::DEFAULT;
+    IndexParameters xxh64 = IndexParameters::from_read_length(150);
+    IndexParameters mx = IndexParameters::from_read_length(150, def, def, def, def, def, def, def, SyncmerHash::MultiplyXorshift);
+    CHECK(xxh64.syncmer.hash == SyncmerHash::XXH64);
+    CHECK(xxh64 != mx);
+    CHECK(xxh64.filename_extension() == ".r150.sti");
+    CHECK(mx.filename_extension() == ".r150.mx.sti");
+
+    CHECK(syncmer_hash_from_string("xxh64") == SyncmerHash::XXH64);
+    CHECK(syncmer_hash_from_string("mx") == SyncmerHash::MultiplyXorshift);
+    CHECK_THROWS_AS(syncmer_hash_from_string("md5"), BadParameter);
+}
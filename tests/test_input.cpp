@@ -1,4 +1,6 @@
+#include <cstdio>
 #include <vector>
+#include <unistd.h>
 #include "doctest.h"
 #include "pc.hpp"
 #include "kseq++/kseq++.hpp"
@@ -43,6 +45,14 @@ TEST_CASE("InputBuffer paired") {
     CHECK(total_se == 0);
 }
 
+TEST_CASE("InputBuffer paired with mismatching mates") {
+    InputBuffer ibuf("tests/phix.1.fastq", "tests/phix.exact.fastq", 3, false);
+    std::vector<klibpp::KSeq> records1;
+    std::vector<klibpp::KSeq> records2;
+    std::vector<klibpp::KSeq> records3;
+    CHECK_THROWS_AS(ibuf.read_records(records1, records2, records3), InvalidFile);
+}
+
 TEST_CASE("InputBuffer single-end (with rewind)") {
     InputBuffer ibuf("tests/phix.1.fastq", "", 3, false);
     std::vector<klibpp::KSeq> records1;
@@ -78,6 +88,90 @@ TEST_CASE("InputBuffer single-end (with rewind)") {
     CHECK(total_se == 45);
 }
 
+TEST_CASE("InputBuffer sharding") {
+    // 45 pairs in chunks of 4 result in 12 chunks, of which shard 2/3 gets
+    // chunks 1, 4, 7 and 10
+    std::vector<std::string> expected_names;
+    {
+        InputBuffer ibuf("tests/phix.1.fastq", "tests/phix.2.fastq", 4, false);
+        std::vector<klibpp::KSeq> records1, records2, records3;
+        while (true) {
+            auto chunk_index = ibuf.read_records(records1, records2, records3);
+            if (records1.empty()) {
+                break;
+            }
+            if (chunk_index % 3 == 1) {
+                for (auto& record : records1) {
+                    expected_names.push_back(record.name);
+                }
+            }
+        }
+    }
+    InputBuffer ibuf("tests/phix.1.fastq", "tests/phix.2.fastq", 4, false);
+    ibuf.set_shard(1, 3);
+    std::vector<klibpp::KSeq> records1, records2, records3;
+    std::vector<size_t> chunk_indices;
+    std::vector<std::string> names;
+    while (true) {
+        auto chunk_index = ibuf.read_records(records1, records2, records3);
+        if (records1.empty()) {
+            break;
+        }
+        chunk_indices.push_back(chunk_index);
+        for (auto& record : records1) {
+            names.push_back(record.name);
+        }
+    }
+    CHECK(chunk_indices == std::vector<size_t>{1, 4, 7, 10});
+    CHECK(names == expected_names);
+}
+
+TEST_CASE("InputBuffer low-latency mode returns partial chunks") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    auto write_record = [&fds](const std::string& name) {
+        std::string record = "@" + name + "\nACGTACGTAC\n+\nIIIIIIIIII\n";
+        REQUIRE(write(fds[1], record.data(), record.size()) == ssize_t(record.size()));
+    };
+    InputBuffer ibuf("/dev/fd/" + std::to_string(fds[0]), "", 100, false);
+    ibuf.set_max_batch_delay(std::chrono::milliseconds(10));
+    std::vector<klibpp::KSeq> records1, records2, records3;
+    std::vector<ChunkReader::time_point> arrival_times;
+
+    // The chunk is returned before it is full and while the input is still open
+    write_record("r1");
+    write_record("r2");
+    ibuf.read_records(records1, records2, records3, -1, &arrival_times);
+    REQUIRE(records3.size() == 2);
+    CHECK(records3[0].name == "r1");
+    CHECK(records3[1].name == "r2");
+    CHECK(arrival_times.size() == 2);
+
+    write_record("r3");
+    ibuf.read_records(records1, records2, records3, -1, &arrival_times);
+    REQUIRE(records3.size() == 1);
+    CHECK(records3[0].name == "r3");
+
+    close(fds[1]);
+    ibuf.read_records(records1, records2, records3, -1, &arrival_times);
+    CHECK(records3.empty());
+    CHECK(arrival_times.empty());
+    CHECK(ibuf.finished_reading);
+    close(fds[0]);
+}
+
+TEST_CASE("LatencyHistogram") {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 100; ++i) {
+        histogram.add(std::chrono::milliseconds(i));
+    }
+    CHECK(histogram.size() == 100);
+    CHECK(histogram.percentile(0.5).count() == doctest::Approx(0.050).epsilon(0.01));
+    CHECK(histogram.percentile(0.99).count() == doctest::Approx(0.099).epsilon(0.01));
+    CHECK(histogram.percentile(1).count() == doctest::Approx(0.100));
+    CHECK(histogram.max().count() == doctest::Approx(0.100));
+}
+
 TEST_CASE("RewindableFile") {
     RewindableFile rf("tests/phix.1.fastq");
     char buf1[1024];
@@ -94,9 +188,48 @@ TEST_CASE("same_name"){
     CHECK(same_name("a", "a"));
     CHECK(same_name("abc", "abc"));
     CHECK(same_name("abc/1", "abc/2"));
+    CHECK(same_name("abc", "abc/2"));
+    CHECK(same_name("abc/1", "abc"));
 
     CHECK(!same_name("a", "b"));
     CHECK(!same_name("a/1", "b/2"));
     CHECK(!same_name("abc/", "abx/"));
     CHECK(!same_name("abc/2", "abc/1"));
+    CHECK(!same_name("abc/2", "abc"));
+}
+
+TEST_CASE("check_mates") {
+    klibpp::KSeq r1, r2;
+    r1.name = "abc";
+    r2.name = "abc";
+    CHECK_NOTHROW(check_mates({r1}, {r2}));
+    r2.name = "abc/2";
+    CHECK_NOTHROW(check_mates({r1}, {r2}));
+    r1.name = "abc/1";
+    CHECK_NOTHROW(check_mates({r1}, {r2}));
+    r2.name = "abd/2";
+    CHECK_THROWS_AS(check_mates({r1}, {r2}), InvalidFile);
+    CHECK_THROWS_AS(check_mates({r1, r1}, {r2}), InvalidFile);
+}
+
+TEST_CASE("Checkpoint write and read") {
+    CHECK(!Checkpoint::read("does-not-exist.checkpoint"));
+
+    Checkpoint checkpoint;
+    checkpoint.arguments = "strobealign -o out.sam ref.fa reads.fq";
+    checkpoint.n_chunks = 17;
+    checkpoint.output_size = 123456;
+    checkpoint.statistics.n_reads = 170000;
+    checkpoint.statistics.tot_extend = std::chrono::duration<double>(2.5);
+    checkpoint.abundances = {1.5, 0, 3};
+    checkpoint.write("tmp.checkpoint");
+    auto read_checkpoint = Checkpoint::read("tmp.checkpoint");
+    std::remove("tmp.checkpoint");
+    REQUIRE(read_checkpoint);
+    CHECK(read_checkpoint->arguments == checkpoint.arguments);
+    CHECK(read_checkpoint->n_chunks == 17);
+    CHECK(read_checkpoint->output_size == 123456);
+    CHECK(read_checkpoint->statistics.n_reads == 170000);
+    CHECK(read_checkpoint->statistics.tot_extend.count() == 2.5);
+    CHECK(read_checkpoint->abundances == checkpoint.abundances);
 }
@@ -0,0 +1,185 @@
+#include "doctest.h"
+#include "nam.hpp"
+#include "index.hpp"
+#include "sequtils.hpp"
+
+namespace {
+
+Nam make_nam(int ref_id, bool is_revcomp, int query_start, int query_end, int ref_start, int ref_end, int n_matches) {
+    Nam nam;
+    nam.query_start = query_start;
+    nam.query_end = query_end;
+    nam.ref_start = ref_start;
+    nam.ref_end = ref_end;
+    nam.ref_id = ref_id;
+    nam.n_matches = n_matches;
+    nam.is_revcomp = is_revcomp;
+    return nam;
+}
+
+}
+
+TEST_CASE("merge_nams_at_same_locus merges NAMs on the same diagonal") {
+    std::vector<Nam> nams{
+        make_nam(0, false, 0, 60, 1000, 1060, 10),
+        make_nam(1, false, 0, 60, 1000, 1060, 6),
+        make_nam(0, false, 80, 120, 1080, 1120, 5),
+        make_nam(0, true, 80, 120, 1080, 1120, 4),
+    };
+    CHECK(merge_nams_at_same_locus(nams, 10, 0) == 1);
+    REQUIRE(nams.size() == 3);
+    CHECK(nams[0].ref_id == 0);
+    CHECK_FALSE(bool(nams[0].is_revcomp));
+    CHECK(nams[0].query_start == 0);
+    CHECK(nams[0].query_end == 120);
+    CHECK(nams[0].ref_start == 1000);
+    CHECK(nams[0].ref_end == 1120);
+    CHECK(int(nams[0].n_matches) == 15);
+    CHECK(nams[1].ref_id == 1);
+    CHECK(bool(nams[2].is_revcomp));
+}
+
+TEST_CASE("merge_nams_at_same_locus keeps the best NAM if diagonals differ") {
+    std::vector<Nam> nams{
+        make_nam(0, false, 0, 60, 1000, 1060, 10),
+        make_nam(0, false, 70, 120, 1075, 1125, 5),
+        make_nam(0, false, 70, 120, 1090, 1140, 4),
+    };
+    // Projected reference starts are 1000, 1005 and 1020
+    CHECK(merge_nams_at_same_locus(nams, 10, 0) == 1);
+    REQUIRE(nams.size() == 2);
+    CHECK(nams[0].query_end == 60);
+    CHECK(nams[0].ref_end == 1060);
+    CHECK(int(nams[0].n_matches) == 15);
+    CHECK(nams[1].ref_start == 1090);
+}
+
+TEST_CASE("merge_nams_at_same_locus sorts by score again") {
+    std::vector<Nam> nams{
+        make_nam(0, false, 0, 60, 1000, 1060, 10),
+        make_nam(0, false, 0, 50, 5000, 5050, 6),
+        make_nam(0, false, 60, 110, 5060, 5110, 6),
+    };
+    CHECK(merge_nams_at_same_locus(nams, 10, 0) == 1);
+    REQUIRE(nams.size() == 2);
+    CHECK(nams[0].ref_start == 5000);
+    CHECK(nams[0].ref_end == 5110);
+    CHECK(int(nams[0].n_matches) == 12);
+    CHECK(nams[1].ref_start == 1000);
+}
+
+TEST_CASE("merge_nams_at_same_locus merges NAMs below the dropoff only into candidates") {
+    std::vector<Nam> nams{
+        make_nam(0, false, 0, 60, 1000, 1060, 10),
+        make_nam(0, false, 0, 60, 3000, 3060, 8),
+        make_nam(0, false, 100, 120, 1100, 1120, 2),
+        make_nam(0, false, 0, 20, 5000, 5020, 2),
+        make_nam(0, false, 30, 50, 5030, 5050, 2),
+    };
+    CHECK(merge_nams_at_same_locus(nams, 10, 0.5) == 1);
+    REQUIRE(nams.size() == 4);
+    CHECK(nams[0].ref_start == 1000);
+    CHECK(nams[0].ref_end == 1120);
+    CHECK(int(nams[0].n_matches) == 12);
+    CHECK(nams[1].ref_start == 3000);
+    // Not merged because neither is a candidate
+    CHECK(nams[2].ref_start == 5000);
+    CHECK(nams[3].ref_start == 5030);
+}
+
+TEST_CASE("lookup_randstrobes gives the same hits and counts as searching the index directly") {
+    // Some segments of phiX are repeated (also as reverse complement) so that
+    // randstrobes are filtered in forward direction or only together with
+    // their reverse complement
+    auto phix = References::from_fasta("tests/phix.fasta").sequences[0];
+    auto segment1 = phix.substr(1000, 500);
+    auto segment2 = phix.substr(3000, 500);
+    std::string repeats1, repeats2;
+    for (int i = 0; i < 120; ++i) {
+        repeats1 += segment1;
+    }
+    for (int i = 0; i < 15; ++i) {
+        repeats2 += segment2;
+    }
+    for (int i = 0; i < 20; ++i) {
+        repeats2 += reverse_complement(segment2);
+    }
+    References references{{phix, repeats1, repeats2}, {"phix", "repeats1", "repeats2"}};
+    auto parameters = IndexParameters::from_read_length(150);
+    StrobemerIndex index(references, parameters);
+    index.populate(0.0002, 1);
+
+    size_t n_filtered = 0;
+    size_t n_partial = 0;
+    for (bool use_mcs : {false, true}) {
+        for (size_t start = 0; start + 150 <= phix.size(); start += 50) {
+            auto query_randstrobes = randstrobes_query(phix.substr(start, 150), parameters);
+            for (int is_revcomp : {0, 1}) {
+                const auto& randstrobes = query_randstrobes[is_revcomp];
+                auto lookups = lookup_randstrobes(randstrobes, index, use_mcs);
+                REQUIRE(lookups.size() == randstrobes.size());
+
+                std::vector<Hit> expected_hits;
+                size_t n_found = 0;
+                for (size_t i = 0; i < randstrobes.size(); ++i) {
+                    const auto& q = randstrobes[i];
+                    const auto& lookup = lookups[i];
+                    size_t position = index.find_full(q.hash);
+                    bool is_partial = false;
+                    if (position == index.end() && use_mcs) {
+                        position = index.find_partial(q.hash);
+                        is_partial = true;
+                    }
+                    REQUIRE(lookup.position == position);
+                    if (position == index.end()) {
+                        continue;
+                    }
+                    CHECK(lookup.is_partial == is_partial);
+                    n_found++;
+
+                    size_t position_revcomp;
+                    unsigned int count;
+                    bool is_filtered;
+                    if (is_partial) {
+                        position_revcomp = index.find_partial(q.hash_revcomp);
+                        count = index.get_count_partial(position);
+                        if (position_revcomp != index.end()) {
+                            count += index.get_count_partial(position_revcomp);
+                        }
+                        is_filtered = index.is_partial_filtered(position, q.hash_revcomp);
+                    } else {
+                        position_revcomp = index.find_full(q.hash_revcomp);
+                        count = index.get_count_full(position);
+                        if (position_revcomp != index.end()) {
+                            count += index.get_count_full(position_revcomp);
+                        }
+                        is_filtered = index.is_filtered(position, q.hash_revcomp);
+                    }
+                    CHECK(lookup.count == count);
+                    CHECK(lookup.is_filtered == is_filtered);
+                    n_filtered += is_filtered;
+                    n_partial += is_partial;
+                    if (!is_filtered) {
+                        expected_hits.push_back(Hit{position, q.start, is_partial ? q.start + index.k() : q.end, is_partial});
+                    }
+                }
+
+                // Without any hits, find_hits() falls back to partial hits in
+                // non-MCS mode, which does not use the lookups
+                auto [total_hits, partial_hits, sorting_needed, hits] = find_hits(randstrobes, lookups, index, use_mcs);
+                if (n_found > 0) {
+                    CHECK(total_hits == static_cast<int>(n_found));
+                    REQUIRE(hits.size() == expected_hits.size());
+                    for (size_t i = 0; i < hits.size(); ++i) {
+                        CHECK(hits[i].position == expected_hits[i].position);
+                        CHECK(hits[i].query_start == expected_hits[i].query_start);
+                        CHECK(hits[i].query_end == expected_hits[i].query_end);
+                        CHECK(hits[i].is_partial == expected_hits[i].is_partial);
+                    }
+                }
+            }
+        }
+    }
+    CHECK(n_filtered > 0);
+    CHECK(n_partial > 0);
+}
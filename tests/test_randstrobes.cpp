@@ -1,7 +1,9 @@
+#include <unordered_map>
 #include "doctest.h"
 #include "randstrobes.hpp"
 #include "revcomp.hpp"
 #include "refs.hpp"
+#include "simd.hpp"
 
 
 std::vector<Syncmer> syncmers_of(std::string& seq, SyncmerParameters parameters) {
@@ -35,6 +37,33 @@ TEST_CASE("SyncmerIterator yields canonical syncmers") {
 }
 
 
+TEST_CASE("Multiply-xorshift hash gives canonical syncmers at a similar density") {
+    auto seq = References::from_fasta("tests/phix.fasta").sequences[0];
+    SyncmerParameters xxh64_parameters{20, 16};
+    SyncmerParameters mx_parameters{20, 16, SyncmerHash::MultiplyXorshift};
+    auto syncmers_xxh64 = syncmers_of(seq, xxh64_parameters);
+    auto syncmers_forward = syncmers_of(seq, mx_parameters);
+    CHECK(syncmers_forward.size() > syncmers_xxh64.size() * 9 / 10);
+    CHECK(syncmers_forward.size() < syncmers_xxh64.size() * 11 / 10);
+
+    std::string seq_reverse = reverse_complement(seq);
+    auto syncmers_reverse = syncmers_of(seq_reverse, mx_parameters);
+    std::reverse(syncmers_reverse.begin(), syncmers_reverse.end());
+    for (auto& it : syncmers_reverse) {
+        it.position = seq.size() - mx_parameters.k - it.position;
+    }
+    CHECK(syncmers_forward == syncmers_reverse);
+
+    // The hash is invertible, so only identical k-mers get identical hashes
+    std::unordered_map<syncmer_hash_t, std::string> kmers;
+    for (auto& syncmer : syncmers_forward) {
+        auto kmer = seq.substr(syncmer.position, mx_parameters.k);
+        auto kmer_revcomp = reverse_complement(kmer);
+        auto [it, inserted] = kmers.emplace(syncmer.hash, std::min(kmer, kmer_revcomp));
+        CHECK(it->second == std::min(kmer, kmer_revcomp));
+    }
+}
+
 TEST_CASE("RefRandstrobe constructor") {
     randstrobe_hash_t hash = 0x1234567890ABCDEF & RANDSTROBE_HASH_MASK;
     uint32_t position = ~0u;
@@ -75,3 +104,98 @@ TEST_CASE("SyncmerIterator") {
     CHECK(!syncmer.is_end());
     CHECK(syncmer.position == 0ul);
 }
+
+TEST_CASE("SyncmerIterator gives the same syncmers at all SIMD levels") {
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto& seq = references.sequences[0];
+    SyncmerParameters parameters{20, 16};
+    auto original_level = simd_level();
+    set_simd_level(SimdLevel::Baseline);
+    auto expected = canonical_syncmers(seq, parameters);
+    CHECK(expected.size() > 100);
+    for (auto level : {SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        set_simd_level(level);
+        auto syncmers = canonical_syncmers(seq, parameters);
+        REQUIRE(syncmers.size() == expected.size());
+        for (size_t i = 0; i < syncmers.size(); ++i) {
+            CHECK(syncmers[i].hash == expected[i].hash);
+            CHECK(syncmers[i].position == expected[i].position);
+        }
+    }
+    set_simd_level(original_level);
+}
+
+TEST_CASE("randstrobes_query matches separately generated reverse complement randstrobes") {
+    auto parameters = IndexParameters::from_read_length(150);
+    std::string seq = References::from_fasta("tests/phix.fasta").sequences[0].substr(0, 1000);
+    // Introduce an N to get a gap in the syncmers
+    seq[500] = 'N';
+    std::string seq_rc = reverse_complement(seq);
+
+    auto randstrobes = randstrobes_query(seq, parameters);
+
+    for (int is_revcomp : {0, 1}) {
+        std::string& s = is_revcomp ? seq_rc : seq;
+        std::vector<Syncmer> syncmers = syncmers_of(s, parameters.syncmer);
+        RandstrobeIterator iterator{syncmers, parameters.randstrobe};
+        std::vector<QueryRandstrobe> expected;
+        while (iterator.has_next()) {
+            auto randstrobe = iterator.next();
+            expected.push_back(QueryRandstrobe{
+                randstrobe.hash, randstrobe.hash_revcomp, randstrobe.strobe1_pos, randstrobe.strobe2_pos + parameters.syncmer.k
+            });
+        }
+        REQUIRE(randstrobes[is_revcomp].size() == expected.size());
+        for (size_t i = 0; i < expected.size(); i++) {
+            CHECK(randstrobes[is_revcomp][i].hash == expected[i].hash);
+            CHECK(randstrobes[is_revcomp][i].hash_revcomp == expected[i].hash_revcomp);
+            CHECK(randstrobes[is_revcomp][i].start == expected[i].start);
+            CHECK(randstrobes[is_revcomp][i].end == expected[i].end);
+        }
+    }
+}
+
+TEST_CASE("remove_low_quality_randstrobes") {
+    auto parameters = IndexParameters::from_read_length(150);
+    const size_t k = parameters.syncmer.k;
+    std::string seq = References::from_fasta("tests/phix.fasta").sequences[0].substr(0, 300);
+    std::string qual(seq.length(), 'I');
+    for (size_t i = 200; i < 210; ++i) {
+        qual[i] = '#';  // Q2
+    }
+    auto randstrobes = randstrobes_query(seq, parameters);
+    const auto all_randstrobes = randstrobes;
+
+    CHECK(remove_low_quality_randstrobes(randstrobes, "", 20, k) == 0);
+    CHECK(remove_low_quality_randstrobes(randstrobes, qual, 0, k) == 0);
+    CHECK(remove_low_quality_randstrobes(randstrobes, qual, 2, k) == 0);
+    CHECK(randstrobes == all_randstrobes);
+
+    size_t n_removed = remove_low_quality_randstrobes(randstrobes, qual, 20, k);
+    CHECK(n_removed > 0);
+    size_t n_expected_removed = 0;
+    for (int is_revcomp : {0, 1}) {
+        std::vector<QueryRandstrobe> expected;
+        for (auto& q : all_randstrobes[is_revcomp]) {
+            // Strobe intervals in forward coordinates
+            size_t start1 = is_revcomp ? seq.length() - q.start - k : q.start;
+            size_t start2 = is_revcomp ? seq.length() - q.end : q.end - k;
+            bool overlaps = false;
+            for (size_t start : {start1, start2}) {
+                overlaps |= start < 210 && start + k > 200;
+            }
+            if (overlaps) {
+                n_expected_removed++;
+            } else {
+                expected.push_back(q);
+            }
+        }
+        CHECK(randstrobes[is_revcomp] == expected);
+    }
+    CHECK(n_removed == n_expected_removed);
+
+    // Nothing is removed if all randstrobes have low quality
+    randstrobes = all_randstrobes;
+    CHECK(remove_low_quality_randstrobes(randstrobes, std::string(seq.length(), '#'), 20, k) == 0);
+    CHECK(randstrobes == all_randstrobes);
+}
@@ -66,13 +66,13 @@ TEST_CASE("Sam::add") {
     aln.score = 9;
     aln.cigar = Cigar("2S2=1X3=3S");
 
-    std::string read_rc = reverse_complement(record.seq);
+    Read read(record.seq);
     bool is_primary = true;
     Details details;
     SUBCASE("Cigar =/X") {
         std::string sam_string;
         Sam sam(sam_string, references);
-        sam.add(aln, record, read_rc, 55, is_primary, details);
+        sam.add(aln, record, read, 55, is_primary, details);
         CHECK(sam_string ==
             "readname\t16\tcontig1\t3\t55\t2S2=1X3=3S\t*\t0\t0\tACGTT\tBB#>\tNM:i:3\tAS:i:9\n"
         );
@@ -80,7 +80,7 @@ TEST_CASE("Sam::add") {
     SUBCASE("Cigar M") {
         std::string sam_string;
         Sam sam(sam_string, references, CigarOps::M);
-        sam.add(aln, record, read_rc, 55, is_primary, details);
+        sam.add(aln, record, read, 55, is_primary, details);
         CHECK(sam_string ==
             "readname\t16\tcontig1\t3\t55\t2S6M3S\t*\t0\t0\tACGTT\tBB#>\tNM:i:3\tAS:i:9\n"
         );
@@ -113,8 +113,8 @@ TEST_CASE("Pair with one unmapped SAM record") {
     record2.name = "readname";
     record2.seq = "GGTT";
     record2.qual = "IHB#";
-    std::string read1_rc = reverse_complement(record1.seq);
-    std::string read2_rc = reverse_complement(record2.seq);
+    Read read1(record1.seq);
+    Read read2(record2.seq);
 
     int mapq1 = 55;
     int mapq2 = 57;
@@ -127,8 +127,8 @@ TEST_CASE("Pair with one unmapped SAM record") {
         aln2,
         record1,
         record2,
-        read1_rc,
-        read2_rc,
+        read1,
+        read2,
         mapq1,
         mapq2,
         is_proper,
@@ -175,8 +175,8 @@ TEST_CASE("TLEN zero when reads map to different contigs") {
     record2.name = "readname";
     record2.seq = "GGTT";
     record2.qual = "IHB#";
-    std::string read1_rc = reverse_complement(record1.seq);
-    std::string read2_rc = reverse_complement(record2.seq);
+    Read read1(record1.seq);
+    Read read2(record2.seq);
 
     int mapq1 = 55;
     int mapq2 = 57;
@@ -191,8 +191,8 @@ TEST_CASE("TLEN zero when reads map to different contigs") {
         aln2,
         record1,
         record2,
-        read1_rc,
-        read2_rc,
+        read1,
+        read2,
         mapq1,
         mapq2,
         is_proper,
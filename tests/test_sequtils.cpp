@@ -0,0 +1,70 @@
+#include <random>
+#include "doctest.h"
+#include "sequtils.hpp"
+#include "simd.hpp"
+
+TEST_CASE("reverse_complement") {
+    CHECK(reverse_complement("") == "");
+    CHECK(reverse_complement("A") == "T");
+    CHECK(reverse_complement("ACGTU") == "AACGT");
+    CHECK(reverse_complement("acgtu") == "AACGT");
+    CHECK(reverse_complement("NRYX-.") == "NNNNNN");
+}
+
+TEST_CASE("to_uppercase") {
+    std::string s = "acgtnACGTNxyz";
+    to_uppercase(s);
+    CHECK(s == "ACGTNACGTNXYZ");
+}
+
+TEST_CASE("encode_nt4") {
+    std::string s = "AaCcGgTtUuNn-";
+    s.push_back(2);
+    std::vector<uint8_t> codes(s.size());
+    encode_nt4(s.data(), s.size(), codes.data());
+    CHECK(codes == std::vector<uint8_t>{0, 0, 1, 1, 2, 2, 3, 3, 3, 3, 4, 4, 4, 2});
+}
+
+TEST_CASE("Sequence functions are the same at all SIMD levels") {
+    // All byte values, and random nucleotides of lengths around the vector sizes
+    std::vector<std::string> sequences;
+    std::string all_bytes;
+    for (int c = 0; c < 256; ++c) {
+        all_bytes.push_back(c);
+    }
+    sequences.push_back(all_bytes);
+    std::minstd_rand engine;
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 150, 1000}) {
+        std::string s;
+        for (size_t i = 0; i < length; ++i) {
+            s += "ACGTNacgtn"[engine() % 10];
+        }
+        sequences.push_back(s);
+    }
+
+    auto original_level = simd_level();
+    set_simd_level(SimdLevel::Baseline);
+    std::vector<std::string> uppercase, revcomp;
+    std::vector<std::vector<uint8_t>> codes;
+    for (auto& s : sequences) {
+        std::string u = s;
+        to_uppercase(u);
+        uppercase.push_back(u);
+        revcomp.push_back(reverse_complement(s));
+        codes.emplace_back(s.size());
+        encode_nt4(s.data(), s.size(), codes.back().data());
+    }
+    for (auto level : {SimdLevel::SSE41, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        set_simd_level(level);
+        for (size_t i = 0; i < sequences.size(); ++i) {
+            std::string u = sequences[i];
+            to_uppercase(u);
+            CHECK(u == uppercase[i]);
+            CHECK(reverse_complement(sequences[i]) == revcomp[i]);
+            std::vector<uint8_t> c(sequences[i].size());
+            encode_nt4(sequences[i].data(), sequences[i].size(), c.data());
+            CHECK(c == codes[i]);
+        }
+    }
+    set_simd_level(original_level);
+}
@@ -8,6 +8,7 @@
 #include "tmpdir.hpp"
 #include "io.hpp"
 #include "revcomp.hpp"
+#include "cmdline.hpp"
 
 
 TEST_CASE("estimate_read_length") {
@@ -57,6 +58,46 @@ TEST_CASE("Missing sti file") {
     REQUIRE_THROWS_AS(index.read((tmp_dir.path() / "index.sti").string()), InvalidIndexFile);
 }
 
+TEST_CASE("Index files of other format versions are rejected") {
+    TemporaryDirectory tmp_dir;
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto parameters = IndexParameters::from_read_length(300);
+    StrobemerIndex index(references, parameters);
+    index.populate(0.0002, 1);
+    std::string sti_path = (tmp_dir.path() / "index.sti").string();
+    index.write(sti_path);
+
+    std::string contents;
+    {
+        std::ifstream ifs{sti_path, std::ios::binary};
+        contents.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+    // The format version follows the magic number
+    contents[4] = 7;
+    {
+        std::ofstream ofs{sti_path, std::ios::binary};
+        ofs << contents;
+    }
+
+    StrobemerIndex old_index(references, parameters);
+    REQUIRE_THROWS_AS(old_index.read(sti_path), InvalidIndexFile);
+}
+
+TEST_CASE("Index created with a different syncmer hash function is rejected") {
+    TemporaryDirectory tmp_dir;
+    auto references = References::from_fasta("tests/phix.fasta");
+    auto parameters = IndexParameters::from_read_length(300);
+    StrobemerIndex index(references, parameters);
+    index.populate(0.0002, 1);
+    std::string sti_path = (tmp_dir.path() / "index.sti").string();
+    index.write(sti_path);
+
+    auto def = IndexParameters::DEFAULT;
+    auto mx_parameters = IndexParameters::from_read_length(300, def, def, def, def, def, def, def, SyncmerHash::MultiplyXorshift);
+    StrobemerIndex mx_index(references, mx_parameters);
+    REQUIRE_THROWS_AS(mx_index.read(sti_path), InvalidIndexFile);
+}
+
 TEST_CASE("Reads file missing") {
     std::string filename("does-not-exist.fastq");
     REQUIRE_THROWS_AS(open_fastq(filename), InvalidFile);
@@ -175,3 +216,12 @@ TEST_CASE("reverse complement") {
 TEST_CASE("pick_bits") {
     CHECK(pick_bits(SyncmerParameters{20, 16}, 0) == 8);
 }
+
+TEST_CASE("parse_shard") {
+    CHECK(parse_shard("1/1") == std::make_pair(size_t{0}, size_t{1}));
+    CHECK(parse_shard("2/5") == std::make_pair(size_t{1}, size_t{5}));
+    CHECK(parse_shard("5/5") == std::make_pair(size_t{4}, size_t{5}));
+    for (auto spec : {"0/5", "6/5", "1", "1/", "/2", "a/2", "1/2x", "-1/2", ""}) {
+        CHECK(parse_shard(spec).second == 0);
+    }
+}